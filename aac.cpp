@@ -2,29 +2,102 @@
 // Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
 
 #include "bluespy_codec_interface.h"
+#include "bluespy_codec_decode_export.h"
+#include "bluespy_codec_error_ring.h"
+#include "bluespy_codec_fingerprint.h"
+#include "bluespy_codec_probes.h"
 
 extern "C" {
 #include "aacdecoder_lib.h"
 }
+#include <algorithm>
 #include <cstring>
 #include <memory>
 #include <vector>
 
+BLUESPY_CODEC_NAMESPACE_BEGIN(aac)
+
 bluespy_codec_info_return bluespy_codec_info() { return {1, "AAC"}; }
 
-struct bluespy_codec_handle {
+struct bluespy_codec_handle BLUESPY_CODEC_HANDLE_BASE {
     HANDLE_AACDECODER aac = nullptr;
     uint32_t sequence_number = -1;
-
-    bluespy_codec_handle() : aac(aacDecoder_Open(TT_MP4_LATM_MCP1, 1)) {}
+    uint32_t byte_offset = 0; // Of the frame being decoded, or the data being filled, in the packet
+    UINT buffer_size = 0;     // Of fdk-aac's input buffer, which is all free when opened
+    bluespy_codec_error_ring<64> errors;
+    unsigned sample_rate = 0, channels = 0;
+    std::unique_ptr<bluespy_codec_fingerprinter> fingerprints; // Set while fingerprinting
+    // Takes a frame that may not fit the host's buffer, up to HE-AAC stereo
+    int16_t spare_frame[2048 * 2];
+
+    bluespy_codec_handle() : aac(aacDecoder_Open(TT_MP4_LATM_MCP1, 1)) {
+        aacDecoder_GetFreeBytes(aac, &buffer_size);
+    }
     bluespy_codec_handle(const bluespy_codec_handle&) = delete;
     bluespy_codec_handle& operator=(const bluespy_codec_handle&) = delete;
     ~bluespy_codec_handle() { aacDecoder_Close(aac); }
+
+    // Logs an FDK error against the current packet, returning result
+    int fail(int32_t error, int result) {
+        errors.push(error, result, (int32_t)sequence_number, byte_offset);
+        return result;
+    }
 };
 
-bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
-                                             int media_codec_type, const void* codec_specific_data,
-                                             int codec_specific_data_len) {
+// A packet may carry several AudioMuxElements, so decode until the buffer runs dry rather than
+// leaving complete frames behind for the next packet. filled is the offset in the packet just past
+// the data given to aacDecoder_Fill. Returns the number of samples written, or a negative
+// BLUESPY_CODEC_ERRORS.
+static int decode_frames(bluespy_codec_handle* handle, int16_t* uncoded_data, uint32_t out_len,
+                         UINT& flags, uint32_t filled) {
+    uint32_t written = 0;
+
+    for (;;) {
+        auto info = aacDecoder_GetStreamInfo(handle->aac);
+        if (!info)
+            return handle->fail(0, BLUESPY_CODEC_RECOVERABLE_ERROR);
+
+        // The next frame starts however many bytes are still buffered before the end of the fill.
+        // Bytes left over from the previous packet put it at the start of this one.
+        UINT free_bytes = handle->buffer_size;
+        aacDecoder_GetFreeBytes(handle->aac, &free_bytes);
+        uint32_t buffered = handle->buffer_size - free_bytes;
+        handle->byte_offset = filled > buffered ? filled - buffered : 0;
+
+        // Whether another frame is buffered is only known by decoding it, so when the rest of the
+        // output might be too small, decode into the spare frame and see
+        int16_t* out = uncoded_data + written;
+        uint32_t out_size = out_len - written;
+
+        if (out_size < uint32_t(info->frameSize * info->numChannels)) {
+            out = handle->spare_frame;
+            out_size = sizeof(handle->spare_frame) / sizeof(int16_t);
+        }
+
+        auto err = aacDecoder_DecodeFrame(handle->aac, out, out_size, flags);
+        if (err == AAC_DEC_NOT_ENOUGH_BITS)
+            break;
+        if (err != AAC_DEC_OK)
+            return handle->fail(err, BLUESPY_CODEC_RECOVERABLE_ERROR);
+
+        // The packet held more than min_bitrate sized the output for. Its input is consumed, so
+        // the frame is lost rather than reported as BLUESPY_CODEC_BUFFER_TOO_SMALL.
+        if (out == handle->spare_frame)
+            return handle->fail(AAC_DEC_OUTPUT_BUFFER_TOO_SMALL, BLUESPY_CODEC_RECOVERABLE_ERROR);
+
+        flags = 0; // History is only cleared ahead of the first frame
+
+        BLUESPY_CODEC_PROBE3(frame, handle, (int32_t)handle->sequence_number,
+                             info->frameSize * info->numChannels);
+        written += info->frameSize * info->numChannels;
+    }
+
+    return written;
+}
+
+static bluespy_codec_init_return init(BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                                      const void* codec_specific_data,
+                                      int codec_specific_data_len) {
     bluespy_codec_init_return r{BLUESPY_CODEC_UNSUPPORTED_CODEC};
     r.seek_pre_frames = 1;
 
@@ -86,36 +159,103 @@ bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
     if (aacDecoder_SetParam(handle->aac, AAC_PCM_MAX_OUTPUT_CHANNELS, r.channels) != AAC_DEC_OK)
         return r;
 
+    handle->sample_rate = r.sample_rate;
+    handle->channels = r.channels;
+
     r.handle = handle.release();
     r.result = BLUESPY_CODEC_SUCCESS;
     r.min_output_size = 1024 * r.channels;
-    r.min_bitrate = -1;
+    // Packets are drained of every frame they hold, so the output buffer must scale with the
+    // packet. No AAC-LC frame is smaller than 4 bytes, i.e. 32 bits per 1024 samples.
+    r.min_bitrate = r.sample_rate / 32;
 
     return r;
 }
 
+bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
+                                             int media_codec_type, const void* codec_specific_data,
+                                             int codec_specific_data_len) {
+    return init(transport, media_codec_type, codec_specific_data, codec_specific_data_len);
+}
+
+// Decoding is serial, so there is nothing to give the executor
+
+bluespy_codec_init_return bluespy_codec_init_ex(BLUESPY_CODEC_TRANSPORT transport,
+                                                int media_codec_type,
+                                                const void* codec_specific_data,
+                                                int codec_specific_data_len,
+                                                const bluespy_codec_executor*) {
+    return init(transport, media_codec_type, codec_specific_data, codec_specific_data_len);
+}
+
 void bluespy_codec_deinit(bluespy_codec_handle* handle) {
     std::unique_ptr<bluespy_codec_handle> p{handle};
 }
 
-int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data, int coded_len,
-                         int16_t* uncoded_data, int uncoded_len) {
-    uint16_t seq = (uint16_t)coded_data[2] << 8 | coded_data[3];
+static int flush(bluespy_codec_handle* handle, int16_t* uncoded_data, int uncoded_len) {
+    if (handle->sequence_number >> 16) // Nothing decoded since the last reset
+        return 0;
 
-    if (coded_len > 0) { // Remove RTP header
-        uint32_t rtp_header_len = 12 + 4 * (*coded_data & 0xF);
+    handle->byte_offset = 0;
 
-        if (coded_len < rtp_header_len)
-            return BLUESPY_CODEC_RECOVERABLE_ERROR;
+    auto info = aacDecoder_GetStreamInfo(handle->aac);
+    if (!info)
+        return handle->fail(0, BLUESPY_CODEC_RECOVERABLE_ERROR);
 
-        coded_data += rtp_header_len;
-        coded_len -= rtp_header_len;
+    int block_size = info->frameSize * info->numChannels;
+
+    if (uncoded_len < block_size)
+        return BLUESPY_CODEC_BUFFER_TOO_SMALL;
+
+    auto err = aacDecoder_DecodeFrame(handle->aac, uncoded_data, uncoded_len, AACDEC_FLUSH);
+    if (err != AAC_DEC_OK)
+        handle->fail(err, BLUESPY_CODEC_RECOVERABLE_ERROR);
+
+    // The next packet then starts with AACDEC_CLRHIST | AACDEC_INTR, which is all the reset the
+    // decoder needs between streams. Logged above first, so the error keeps the last packet's
+    // sequence number.
+    handle->sequence_number = -1;
+
+    return err == AAC_DEC_OK ? block_size : BLUESPY_CODEC_RECOVERABLE_ERROR;
+}
+
+static int decode(bluespy_codec_handle* handle, const uint8_t* coded_data, int coded_len,
+                  int16_t* uncoded_data, int uncoded_len) {
+    if (coded_len <= 0) // End of stream
+        return flush(handle, uncoded_data, uncoded_len);
+
+    if (coded_len < 12) {
+        handle->errors.push(0, BLUESPY_CODEC_RECOVERABLE_ERROR, -1, 0);
+        return BLUESPY_CODEC_RECOVERABLE_ERROR;
     }
 
+    uint16_t seq = (uint16_t)coded_data[2] << 8 | coded_data[3];
+
+    // Remove RTP header
+    uint32_t rtp_header_len = 12 + 4 * (*coded_data & 0xF);
+
+    if (coded_len < rtp_header_len) {
+        handle->errors.push(0, BLUESPY_CODEC_RECOVERABLE_ERROR, seq, 0);
+        return BLUESPY_CODEC_RECOVERABLE_ERROR;
+    }
+
+    coded_data += rtp_header_len;
+    coded_len -= rtp_header_len;
+
+    // Only refuse the packet before any of it is consumed, so the host can retry with more room
+    auto info = aacDecoder_GetStreamInfo(handle->aac);
+    if (!info)
+        return handle->fail(0, BLUESPY_CODEC_RECOVERABLE_ERROR);
+
+    if (uncoded_len < std::max(info->frameSize, 1024) * (int)handle->channels)
+        return BLUESPY_CODEC_BUFFER_TOO_SMALL;
+
     UINT flags = 0;
 
-    if (((seq - handle->sequence_number) & 0xFFFF) != 1 || handle->sequence_number >> 16)
+    if (((seq - handle->sequence_number) & 0xFFFF) != 1 || handle->sequence_number >> 16) {
+        BLUESPY_CODEC_PROBE3(history_reset, handle, seq, (int32_t)handle->sequence_number);
         flags |= AACDEC_CLRHIST | AACDEC_INTR;
+    }
 
     handle->sequence_number = seq;
 
@@ -123,27 +263,35 @@ int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data
 
     while (valid) {
         uint32_t size = valid;
-        if (aacDecoder_Fill(handle->aac, const_cast<uint8_t**>(&coded_data), &size, &valid) !=
-            AAC_DEC_OK)
-            return BLUESPY_CODEC_RECOVERABLE_ERROR;
+        handle->byte_offset = rtp_header_len + coded_len - valid;
 
-        coded_data += size - valid;
-
-        auto info = aacDecoder_GetStreamInfo(handle->aac);
-        if (!info)
-            return BLUESPY_CODEC_RECOVERABLE_ERROR;
+        auto err =
+            aacDecoder_Fill(handle->aac, const_cast<uint8_t**>(&coded_data), &size, &valid);
+        if (err != AAC_DEC_OK)
+            return handle->fail(err, BLUESPY_CODEC_RECOVERABLE_ERROR);
 
-        uint32_t block_size = info->frameSize * info->numChannels;
+        coded_data += size - valid;
 
-        if (out_len < block_size)
-            return BLUESPY_CODEC_BUFFER_TOO_SMALL;
+        int written =
+            decode_frames(handle, uncoded_data, out_len, flags, rtp_header_len + coded_len - valid);
+        if (written < 0)
+            return written;
 
-        if (aacDecoder_DecodeFrame(handle->aac, uncoded_data, out_len, flags) != AAC_DEC_OK)
-            return BLUESPY_CODEC_RECOVERABLE_ERROR;
+        // fdk-aac's buffer is full but holds no whole frame, so it would never take more
+        if (size == valid && !written)
+            return handle->fail(0, BLUESPY_CODEC_RECOVERABLE_ERROR);
 
-        uncoded_data += block_size;
-        out_len -= block_size;
+        uncoded_data += written;
+        out_len -= written;
     }
 
     return uncoded_len - out_len;
 }
+
+BLUESPY_CODEC_DECODE_EXPORT(decode)
+
+BLUESPY_CODEC_ERROR_RING_EXPORTS
+
+BLUESPY_CODEC_FINGERPRINT_EXPORTS
+
+BLUESPY_CODEC_NAMESPACE_END
@@ -2,29 +2,59 @@
 // Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
 
 #include "bluespy_codec_interface.h"
+#include "bluespy_codec_decode_export.h"
+#include "bluespy_codec_error_ring.h"
+#include "bluespy_codec_fingerprint.h"
+#include "bluespy_codec_probes.h"
+#include "aptx_codec_ids.h" // Generated from the manifest entries in CMakeLists.txt
 
 extern "C" {
 #include "freeaptx.h"
+
+// aptx_decode, also returning the energy and step size of each subband (see aptx_subbands.c)
+size_t aptx_decode_subbands(struct aptx_context* ctx, const unsigned char* input,
+                            size_t input_size, unsigned char* output, size_t output_size,
+                            size_t* written, float energy[2][8], int32_t step_size[2][8]);
 }
 #include <cstring>
+#include <memory>
 #include <vector>
 
+BLUESPY_CODEC_NAMESPACE_BEGIN(aptx)
+
 bluespy_codec_info_return bluespy_codec_info() { return {1, "aptX"}; }
 
-struct bluespy_codec_handle {
+// libfreeaptx only reports how far it got, so this is logged when it stops before the end of a
+// packet, i.e. on a synchronisation (parity) error.
+const int32_t APTX_SYNC_ERROR = 1;
+
+enum RTP_HEADER { RTP_UNKNOWN, RTP_PROBING, RTP_PRESENT, RTP_ABSENT };
+
+struct bluespy_codec_handle BLUESPY_CODEC_HANDLE_BASE {
     struct aptx_context* aptx = nullptr;
     bool hd = false;
+    RTP_HEADER rtp = RTP_UNKNOWN;
+    int32_t sequence_number = -1; // Of the current packet, -1 without an RTP header
+    uint16_t probe_sequence_number = 0;
+    uint32_t probe_timestamp = 0;
+    uint32_t probe_samples = 0;
+    bool collect_subbands = false;
+    bluespy_codec_subbands subbands{2, 4};
     std::vector<uint8_t> output;
+    bluespy_codec_error_ring<64> errors;
+    unsigned sample_rate = 0, channels = 0;
+    std::unique_ptr<bluespy_codec_fingerprinter> fingerprints; // Set while fingerprinting
 
-    bluespy_codec_handle(bool hd) : aptx(aptx_init(hd)), hd(hd) {}
+    bluespy_codec_handle(bool hd)
+        : aptx(aptx_init(hd)), hd(hd), rtp(hd ? RTP_PRESENT : RTP_UNKNOWN) {}
     bluespy_codec_handle(const bluespy_codec_handle&) = delete;
     bluespy_codec_handle& operator=(const bluespy_codec_handle&) = delete;
     ~bluespy_codec_handle() { aptx_finish(aptx); }
 };
 
-bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
-                                             int media_codec_type, const void* codec_specific_data,
-                                             int codec_specific_data_len) {
+static bluespy_codec_init_return init(BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                                      const void* codec_specific_data,
+                                      int codec_specific_data_len) {
     bluespy_codec_init_return r{BLUESPY_CODEC_UNSUPPORTED_CODEC};
     bool hd = false;
 
@@ -37,12 +67,13 @@ bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
     memcpy(&vendor, codec_specific_data, 4);
     memcpy(&codec_id, (const char*)codec_specific_data + 4, 2);
 
-    if (vendor == 0x4F && codec_id == 0x1) {
+    if (vendor == APTX_VENDOR && codec_id == APTX_CODEC_ID) {
         r.codec_name = "aptX";
-    } else if (vendor == 0xD7 && codec_id == 0x24) {
+    } else if (vendor == APTX_HD_VENDOR && codec_id == APTX_HD_CODEC_ID) {
         r.codec_name = "aptX HD";
         hd = true;
-    } else if ((vendor == 0xD7 || vendor == 0xA) && codec_id == 0x2) {
+    } else if ((vendor == APTX_LL_VENDOR && codec_id == APTX_LL_CODEC_ID) ||
+               (vendor == APTX_LL_ALT_VENDOR && codec_id == APTX_LL_ALT_CODEC_ID)) {
         r.codec_name = "aptX LL";
     } else {
         return r;
@@ -78,7 +109,11 @@ bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
         return r;
     }
 
-    r.handle = new bluespy_codec_handle{hd};
+    auto handle = new bluespy_codec_handle{hd};
+    handle->sample_rate = r.sample_rate;
+    handle->channels = r.channels;
+
+    r.handle = handle;
     r.result = BLUESPY_CODEC_SUCCESS;
     r.min_output_size = 4;
     r.min_bitrate = hd ? 12 * r.sample_rate : 8 * r.sample_rate;
@@ -86,16 +121,88 @@ bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
     return r;
 }
 
+bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
+                                             int media_codec_type, const void* codec_specific_data,
+                                             int codec_specific_data_len) {
+    return init(transport, media_codec_type, codec_specific_data, codec_specific_data_len);
+}
+
+// Decoding is serial, so there is nothing to give the executor
+bluespy_codec_init_return bluespy_codec_init_ex(BLUESPY_CODEC_TRANSPORT transport,
+                                                int media_codec_type,
+                                                const void* codec_specific_data,
+                                                int codec_specific_data_len,
+                                                const bluespy_codec_executor*) {
+    return init(transport, media_codec_type, codec_specific_data, codec_specific_data_len);
+}
+
 void bluespy_codec_deinit(bluespy_codec_handle* handle) { delete handle; }
 
-int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data, int coded_len,
-                         int16_t* uncoded_data, int uncoded_len) {
-    if (coded_len > 0 && handle->hd) { // Remove RTP header - only present on aptX HD
-        uint32_t rtp_header_len = 12 + 4 * (*coded_data & 0xF);
+// aptX HD always carries an RTP header, but standard aptX only does on some stacks. Treat the first
+// packet as RTP if it has a version 2 header with no extension or CSRCs and a dynamic payload type,
+// then confirm on the next packet by checking that the sequence number and timestamp advance
+// plausibly. The result is latched for the rest of the stream.
+static void detect_rtp_header(bluespy_codec_handle* handle, const uint8_t* coded_data,
+                              int coded_len) {
+    const int rtp_header_len = 12;
+
+    // Version 2, any padding bit, no extension, no CSRCs, then a payload type of 96 or more
+    if (coded_len < rtp_header_len || (coded_data[0] & 0xDF) != 0x80 ||
+        (coded_data[1] & 0x7F) < 96) {
+        if (handle->rtp == RTP_PROBING) // The previous packet was decoded from the wrong offset
+            aptx_reset(handle->aptx);
+        handle->rtp = RTP_ABSENT;
+        return;
+    }
+
+    uint16_t seq = (uint16_t)coded_data[2] << 8 | coded_data[3];
+    uint32_t timestamp = (uint32_t)coded_data[4] << 24 | (uint32_t)coded_data[5] << 16 |
+                         (uint32_t)coded_data[6] << 8 | coded_data[7];
+
+    if (handle->rtp == RTP_PROBING) {
+        if (seq == handle->probe_sequence_number && timestamp == handle->probe_timestamp)
+            return; // The probe packet retried with a larger buffer
 
-        if (coded_len < rtp_header_len)
+        // Allow for a few lost packets between the two, with the timestamp advancing in proportion
+        uint16_t gap = seq - handle->probe_sequence_number;
+        uint32_t step = timestamp - handle->probe_timestamp;
+        bool plausible = gap >= 1 && gap <= 8 && step && step <= 4 * gap * handle->probe_samples;
+
+        if (!plausible)
+            aptx_reset(handle->aptx);
+        handle->rtp = plausible ? RTP_PRESENT : RTP_ABSENT;
+        return;
+    }
+
+    handle->rtp = RTP_PROBING;
+    handle->probe_sequence_number = seq;
+    handle->probe_timestamp = timestamp;
+    handle->probe_samples = 4 * ((coded_len - rtp_header_len) / 4);
+}
+
+static int decode(bluespy_codec_handle* handle, const uint8_t* coded_data, int coded_len,
+                  int16_t* uncoded_data, int uncoded_len) {
+    handle->sequence_number = -1;
+
+    if (coded_len <= 0) { // End of stream, libfreeaptx has no tail to flush so just reset
+        aptx_reset(handle->aptx);
+        return 0;
+    }
+
+    if (handle->rtp == RTP_UNKNOWN || handle->rtp == RTP_PROBING)
+        detect_rtp_header(handle, coded_data, coded_len);
+
+    uint32_t rtp_header_len = 0;
+
+    if (handle->rtp != RTP_ABSENT) { // Remove RTP header
+        rtp_header_len = 12 + 4 * (*coded_data & 0xF);
+
+        if (coded_len < rtp_header_len) {
+            handle->errors.push(0, BLUESPY_CODEC_RECOVERABLE_ERROR, -1, 0);
             return BLUESPY_CODEC_RECOVERABLE_ERROR;
+        }
 
+        handle->sequence_number = (uint16_t)coded_data[2] << 8 | coded_data[3];
         coded_data += rtp_header_len;
         coded_len -= rtp_header_len;
     }
@@ -108,9 +215,21 @@ int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data
 
     handle->output.resize(3 * out_total_samples);
 
-    size_t written = 0;
-    aptx_decode(handle->aptx, coded_data, coded_len, handle->output.data(), handle->output.size(),
-                &written);
+    size_t written = 0, processed;
+    if (handle->collect_subbands)
+        processed = aptx_decode_subbands(handle->aptx, coded_data, coded_len,
+                                         handle->output.data(), handle->output.size(), &written,
+                                         handle->subbands.energy, handle->subbands.step_size);
+    else
+        processed = aptx_decode(handle->aptx, coded_data, coded_len, handle->output.data(),
+                                handle->output.size(), &written);
+
+    BLUESPY_CODEC_PROBE4(aptx_decode, handle, handle->sequence_number, coded_len, written / 3);
+
+    // A trailing partial codeword is not an error, anything else left over is
+    if (coded_len - processed >= (handle->hd ? 6 : 4))
+        handle->errors.push(APTX_SYNC_ERROR, BLUESPY_CODEC_SUCCESS, handle->sequence_number,
+                            rtp_header_len + processed);
 
     for (int i = 0; i < written; i += 3) {
         *uncoded_data++ = (int16_t)handle->output[i + 1] | ((int16_t)handle->output[i + 2] << 8);
@@ -118,3 +237,25 @@ int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data
 
     return written / 3;
 }
+
+BLUESPY_CODEC_DECODE_EXPORT(decode)
+
+BLUESPY_CODEC_ERRORS bluespy_codec_enable_subbands(bluespy_codec_handle* handle, int enable) {
+    handle->collect_subbands = enable;
+    return BLUESPY_CODEC_SUCCESS;
+}
+
+BLUESPY_CODEC_ERRORS bluespy_codec_get_subbands(bluespy_codec_handle* handle,
+                                                bluespy_codec_subbands* subbands) {
+    if (!handle->collect_subbands)
+        return BLUESPY_CODEC_UNSUPPORTED_CODEC;
+
+    *subbands = handle->subbands;
+    return BLUESPY_CODEC_SUCCESS;
+}
+
+BLUESPY_CODEC_ERROR_RING_EXPORTS
+
+BLUESPY_CODEC_FINGERPRINT_EXPORTS
+
+BLUESPY_CODEC_NAMESPACE_END
@@ -0,0 +1,48 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// libfreeaptx keeps its context private, so it is compiled as part of this file to let the decoder
+// state be read back between codewords.
+#include "freeaptx.c"
+
+size_t aptx_decode_subbands(struct aptx_context* ctx, const unsigned char* input,
+                            size_t input_size, unsigned char* output, size_t output_size,
+                            size_t* written, float energy[2][8], int32_t step_size[2][8]) {
+    const size_t sample_size = ctx->hd ? 6 : 4;
+    double sum[NB_CHANNELS][NB_SUBBANDS] = {{0}};
+    size_t ipos = 0, codewords = 0;
+    int channel, subband;
+
+    *written = 0;
+
+    // Each codeword carries one sample of every subband, which is left in the predictor once the
+    // codeword has been synthesised.
+    while (ipos + sample_size <= input_size) {
+        size_t out = 0;
+
+        if (aptx_decode(ctx, input + ipos, sample_size, output + *written, output_size - *written,
+                        &out) != sample_size)
+            break;
+
+        ipos += sample_size;
+        *written += out;
+        ++codewords;
+
+        for (channel = 0; channel < NB_CHANNELS; channel++)
+            for (subband = 0; subband < NB_SUBBANDS; subband++) {
+                double s = ctx->channels[channel].prediction[subband].previous_reconstructed_sample;
+                sum[channel][subband] += s * s;
+            }
+    }
+
+    for (channel = 0; channel < NB_CHANNELS; channel++)
+        for (subband = 0; subband < NB_SUBBANDS; subband++) {
+            // Relative to a full scale 24 bit sample
+            energy[channel][subband] =
+                codewords ? (float)(sum[channel][subband] / codewords / (1 << 23) / (1 << 23)) : 0;
+            step_size[channel][subband] =
+                ctx->channels[channel].invert_quantize[subband].quantization_factor;
+        }
+
+    return ipos;
+}
@@ -0,0 +1,31 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_DECODE_EXPORT_H
+#define BLUESPY_CODEC_DECODE_EXPORT_H
+
+#include "bluespy_codec_interface.h"
+#include "bluespy_codec_fingerprint.h"
+#include "bluespy_codec_probes.h"
+
+// Defines bluespy_codec_decode around the plugin's own decode function, which takes the same
+// arguments. It fires the decode_entry, error and decode_exit probes with the handle's
+// sequence_number, and passes the output to the handle's fingerprints while those are enabled (see
+// BLUESPY_CODEC_FINGERPRINT_EXPORTS).
+#define BLUESPY_CODEC_DECODE_EXPORT(decode)                                                        \
+    int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data,              \
+                             int coded_len, int16_t* uncoded_data, int uncoded_len) {              \
+        BLUESPY_CODEC_PROBE3(decode_entry, handle, coded_len, uncoded_len);                        \
+                                                                                                   \
+        int r = decode(handle, coded_data, coded_len, uncoded_data, uncoded_len);                  \
+                                                                                                   \
+        if (r < 0)                                                                                 \
+            BLUESPY_CODEC_PROBE4(error, handle, (int32_t)handle->sequence_number, r, coded_len);   \
+        else if (handle->fingerprints)                                                             \
+            handle->fingerprints->add(uncoded_data, r);                                            \
+        BLUESPY_CODEC_PROBE4(decode_exit, handle, (int32_t)handle->sequence_number, coded_len, r); \
+                                                                                                   \
+        return r;                                                                                  \
+    }
+
+#endif
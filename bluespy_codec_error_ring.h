@@ -0,0 +1,57 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_ERROR_RING_H
+#define BLUESPY_CODEC_ERROR_RING_H
+
+#include "bluespy_codec_interface.h"
+
+#include <atomic>
+
+// Fixed size record of recent decode failures, kept in each handle for bluespy_codec_drain_errors.
+// The decoding thread pushes and any one other thread drains, without locks. When full, new
+// entries are dropped and counted in the next entry that fits.
+template <uint32_t Size> class bluespy_codec_error_ring {
+    static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+  public:
+    void push(int32_t error, int32_t result, int32_t sequence_number, uint32_t byte_offset) {
+        uint32_t head = head_.load(std::memory_order_relaxed);
+
+        if (head - tail_.load(std::memory_order_acquire) == Size) {
+            ++dropped;
+            return;
+        }
+
+        entries[head % Size] = {error, result, sequence_number, byte_offset, dropped};
+        dropped = 0;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    int drain(bluespy_codec_error_detail* errors, int max_errors) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        int n = 0;
+
+        for (; tail != head && n < max_errors; ++tail)
+            errors[n++] = entries[tail % Size];
+
+        tail_.store(tail, std::memory_order_release);
+        return n;
+    }
+
+  private:
+    bluespy_codec_error_detail entries[Size];
+    uint32_t dropped = 0; // Only touched by the pushing thread
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+};
+
+// Defines bluespy_codec_drain_errors for a plugin whose handle keeps its ring as 'errors'
+#define BLUESPY_CODEC_ERROR_RING_EXPORTS                                                           \
+    int bluespy_codec_drain_errors(bluespy_codec_handle* handle,                                   \
+                                   bluespy_codec_error_detail* errors, int max_errors) {           \
+        return handle->errors.drain(errors, max_errors);                                           \
+    }
+
+#endif
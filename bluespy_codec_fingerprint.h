@@ -0,0 +1,166 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_FINGERPRINT_H
+#define BLUESPY_CODEC_FINGERPRINT_H
+
+#include "bluespy_codec_interface.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <vector>
+
+// Computes audio fingerprints from decoded PCM as it is produced, for
+// bluespy_codec_enable_fingerprints. These are the 32 bit sub-fingerprints of Haitsma & Kalker:
+// the output is mixed to mono and resampled to 6.4 kHz, then each 2048 sample window gives the
+// energies of 33 log spaced bands between 300 and 2000 Hz. Bit m of a window's fingerprint is set
+// if the energy difference between bands m and m+1 grew since the previous window. Windows start
+// every 10 ms whatever the stream's sample rate, so fingerprints of the same material at different
+// rates line up, and overlap by 31/32, so matching tolerates any alignment. See
+// include/bluespy_codec_fingerprint.hpp for the matcher.
+class bluespy_codec_fingerprinter {
+  public:
+    static const int window = 2048;
+    static const int step = 64;   // Resampled samples between windows
+    static const int rate = 6400; // Resampled samples per second, so windows are 10 ms apart
+    static const int bands = 33;
+
+    bluespy_codec_fingerprinter(unsigned sample_rate, unsigned channels)
+        : sample_rate(std::max(1u, sample_rate)), channels(channels), history(window), hann(window),
+          twiddles(window / 2), spectrum(window), previous(bands - 1) {
+        const double pi = 3.14159265358979323846;
+
+        for (int i = 0; i < window; ++i)
+            hann[i] = float(0.5 - 0.5 * std::cos(2 * pi * i / window));
+
+        for (int i = 0; i < window / 2; ++i)
+            twiddles[i] = std::polar(1.0f, float(-2 * pi * i / window));
+
+        for (int b = 0; b <= bands; ++b) {
+            double f = 300 * std::pow(2000.0 / 300, double(b) / bands);
+            edges[b] = std::min(window / 2, int(f * window / rate + 0.5));
+        }
+    }
+
+    // Output samples per channel between the starts of consecutive windows, exact for any rate
+    // that is a multiple of 100 Hz
+    unsigned hop() const { return (sample_rate * step + rate / 2) / rate; }
+
+    void add(const int16_t* pcm, int samples) {
+        for (int i = 0; i < samples; i += channels) {
+            double sum = 0;
+            for (unsigned c = 0; c < channels; ++c)
+                sum += pcm[i + c];
+
+            // Each resampled sample is the mean of the input over its period. Time is counted in
+            // units of 1/(rate * sample_rate) s, so an input sample lasts rate units and a
+            // resampled one sample_rate units, and there is no rounding to drift.
+            for (unsigned left = rate; left;) {
+                unsigned take = std::min(left, sample_rate - filled);
+                accumulator += sum * take;
+                filled += take;
+                left -= take;
+
+                if (filled < sample_rate)
+                    continue;
+
+                history[written++ % window] =
+                    float(accumulator / (double(sample_rate) * channels * 32768));
+                accumulator = 0;
+                filled = 0;
+
+                if (written >= window && written % step == 0)
+                    fingerprint();
+            }
+        }
+    }
+
+    // Takes up to max_fingerprints, returning how many were written. first_window is the index
+    // of the first, counting from the start of the stream.
+    int drain(uint32_t* fingerprints, int max_fingerprints, uint64_t* first_window) {
+        int n = std::min<size_t>(max_fingerprints, pending.size());
+
+        *first_window = pending_first;
+        std::copy(pending.begin(), pending.begin() + n, fingerprints);
+        pending.erase(pending.begin(), pending.begin() + n);
+        pending_first += n;
+
+        return n;
+    }
+
+  private:
+    void fingerprint() {
+        // Load the window in bit reversed order, then an in-place radix-2 FFT
+        for (int i = 0, j = 0; i < window; ++i) {
+            spectrum[j] = history[(written + i) % window] * hann[i];
+            for (int bit = window >> 1; (j ^= bit) < bit; bit >>= 1)
+                ;
+        }
+
+        for (int len = 2; len <= window; len <<= 1)
+            for (int i = 0; i < window; i += len)
+                for (int k = 0; k < len / 2; ++k) {
+                    auto t = twiddles[k * (window / len)] * spectrum[i + k + len / 2];
+                    spectrum[i + k + len / 2] = spectrum[i + k] - t;
+                    spectrum[i + k] += t;
+                }
+
+        float energy[bands];
+        for (int b = 0; b < bands; ++b) {
+            energy[b] = 0;
+            for (int k = edges[b]; k < edges[b + 1]; ++k)
+                energy[b] += std::norm(spectrum[k]);
+        }
+
+        uint32_t bits = 0;
+        for (int m = 0; m < bands - 1; ++m) {
+            float difference = energy[m] - energy[m + 1];
+            if (difference - previous[m] > 0)
+                bits |= 1u << m;
+            previous[m] = difference;
+        }
+
+        // The first window has nothing to compare against
+        if (written > window)
+            pending.push_back(bits);
+    }
+
+    unsigned sample_rate;
+    unsigned channels;
+    double accumulator = 0;
+    unsigned filled = 0;  // Of the resampled sample being accumulated, in the units of add()
+    uint64_t written = 0; // Resampled samples
+    std::vector<float> history;
+    std::vector<float> hann;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<std::complex<float>> spectrum;
+    std::vector<float> previous;
+    int edges[bands + 1];
+    std::vector<uint32_t> pending;
+    uint64_t pending_first = 1;
+};
+
+// Defines bluespy_codec_enable_fingerprints and bluespy_codec_drain_fingerprints for a plugin whose
+// handle has sample_rate, channels and a std::unique_ptr<bluespy_codec_fingerprinter> fingerprints
+#define BLUESPY_CODEC_FINGERPRINT_EXPORTS                                                          \
+    int bluespy_codec_enable_fingerprints(bluespy_codec_handle* handle, int enable) {              \
+        if (!enable)                                                                               \
+            handle->fingerprints.reset();                                                          \
+        else if (!handle->fingerprints)                                                            \
+            handle->fingerprints.reset(                                                            \
+                new bluespy_codec_fingerprinter(handle->sample_rate, handle->channels));           \
+                                                                                                   \
+        return handle->fingerprints ? handle->fingerprints->hop() : 0;                             \
+    }                                                                                              \
+                                                                                                   \
+    int bluespy_codec_drain_fingerprints(bluespy_codec_handle* handle, uint32_t* fingerprints,     \
+                                         int max_fingerprints, uint64_t* first_window) {           \
+        if (!handle->fingerprints)                                                                 \
+            return BLUESPY_CODEC_UNSUPPORTED_CODEC;                                                \
+                                                                                                   \
+        return handle->fingerprints->drain(fingerprints, max_fingerprints, first_window);          \
+    }
+
+#endif
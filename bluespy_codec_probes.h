@@ -0,0 +1,30 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_PROBES_H
+#define BLUESPY_CODEC_PROBES_H
+
+// USDT probe points for tracing the plugins without a rebuild, e.g.
+//   bpftrace -e 'usdt:./aac.so:bluespy_codec:decode_exit { @[arg3 < 0] = count(); }'
+// Each probe is a single nop until a tracer attaches. Without <sys/sdt.h> (BLUESPY_CODEC_USDT not
+// defined) they compile to no-op statements.
+//
+// Probes, all with the handle as arg0 and the RTP sequence number (-1 if unknown) as arg1 where
+// given:
+//   decode_entry(handle, coded_len, uncoded_len)
+//   decode_exit(handle, seq, coded_len, result)
+//   error(handle, seq, error, coded_len)
+//   history_reset(handle, seq, previous_seq)
+//   frame(handle, seq, samples)                      AAC and LC3plus, once per decoded frame
+//   aptx_decode(handle, seq, bytes, samples)         aptX, once per call to libfreeaptx
+
+#ifdef BLUESPY_CODEC_USDT
+#include <sys/sdt.h>
+#define BLUESPY_CODEC_PROBE3(name, a, b, c) STAP_PROBE3(bluespy_codec, name, a, b, c)
+#define BLUESPY_CODEC_PROBE4(name, a, b, c, d) STAP_PROBE4(bluespy_codec, name, a, b, c, d)
+#else
+#define BLUESPY_CODEC_PROBE3(name, a, b, c) ((void)0)
+#define BLUESPY_CODEC_PROBE4(name, a, b, c, d) ((void)0)
+#endif
+
+#endif
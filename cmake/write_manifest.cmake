@@ -0,0 +1,17 @@
+# Writes the capability manifest for a codec plugin, run after linking so the hash matches the
+# library. Expects LIBRARY, MANIFEST, CODEC_NAME, ABI_VERSION and CODECS (a list of
+# transport:media_codec_type[:vendor:codec_id] entries).
+
+file(SHA256 "${LIBRARY}" hash)
+get_filename_component(library_name "${LIBRARY}" NAME)
+
+set(content "# blueSPY codec plugin manifest\n")
+string(APPEND content "abi_version=${ABI_VERSION}\n")
+string(APPEND content "codec_name=${CODEC_NAME}\n")
+string(APPEND content "library=${library_name}\n")
+string(APPEND content "sha256=${hash}\n")
+foreach(codec IN LISTS CODECS)
+    string(APPEND content "codec=${codec}\n")
+endforeach()
+
+file(WRITE "${MANIFEST}" "${content}")
@@ -0,0 +1,143 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_FINGERPRINT_HPP
+#define BLUESPY_CODEC_FINGERPRINT_HPP
+
+// Matches fingerprints from bluespy_codec_drain_fingerprints against a database of reference
+// tracks. Each reference window is indexed by its 32 bit fingerprint in one sorted array, so the
+// database costs 16 bytes per window and a lookup is a binary search. Candidate alignments from
+// exact hits are then checked by bit error rate over the whole query.
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace bluespy_codec_fingerprint {
+
+struct match {
+    uint32_t track = 0;
+    int64_t window = 0; // Window of the track that lines up with the first query fingerprint
+    float bit_error_rate = 1;
+};
+
+class database {
+  public:
+    // Fingerprints of silence and other common windows are not worth indexing
+    explicit database(size_t max_postings = 64) : max_postings(max_postings) {}
+
+    void add_track(uint32_t track, const uint32_t* fingerprints, size_t n) {
+        if (tracks.size() <= track)
+            tracks.resize(track + 1);
+
+        auto& t = tracks[track];
+        uint32_t base = (uint32_t)t.size();
+        t.insert(t.end(), fingerprints, fingerprints + n);
+
+        for (size_t i = 0; i < n; ++i)
+            postings.push_back({fingerprints[i], track, base + (uint32_t)i});
+
+        sorted = false;
+    }
+
+    /**
+     * @brief find
+     * @param[in] fingerprints Consecutive fingerprints from one stream
+     * @param[in] n At least a few hundred (a few seconds) for a reliable match
+     * @param[in] threshold Highest bit error rate accepted as the same content
+     * @param[out] best The best alignment found
+     * @return true if the best alignment is within the threshold
+     */
+    bool find(const uint32_t* fingerprints, size_t n, match& best, float threshold = 0.35f) {
+        if (!sorted) {
+            std::sort(postings.begin(), postings.end());
+            sorted = true;
+        }
+
+        // Vote for (track, offset) pairs from exact hits
+        std::unordered_map<uint64_t, uint32_t> votes;
+
+        for (size_t i = 0; i < n; ++i) {
+            auto range = std::equal_range(postings.begin(), postings.end(),
+                                          posting{fingerprints[i], 0, 0}, by_fingerprint);
+            if (size_t(range.second - range.first) > max_postings)
+                continue;
+
+            for (auto p = range.first; p != range.second; ++p) {
+                int64_t offset = int64_t(p->window) - int64_t(i);
+                ++votes[uint64_t(p->track) << 32 | uint32_t(offset)];
+            }
+        }
+
+        std::vector<std::pair<uint32_t, uint64_t>> candidates;
+        for (const auto& v : votes)
+            candidates.push_back({v.second, v.first});
+
+        size_t checked = std::min<size_t>(candidates.size(), 8);
+        std::partial_sort(candidates.begin(), candidates.begin() + checked, candidates.end(),
+                          [](const std::pair<uint32_t, uint64_t>& a,
+                             const std::pair<uint32_t, uint64_t>& b) { return a.first > b.first; });
+
+        best = match();
+
+        for (size_t c = 0; c < checked; ++c) {
+            uint32_t track = uint32_t(candidates[c].second >> 32);
+            int64_t offset = int32_t(uint32_t(candidates[c].second));
+            float ber = bit_error_rate(tracks[track], offset, fingerprints, n);
+
+            if (ber < best.bit_error_rate) {
+                best.track = track;
+                best.window = offset;
+                best.bit_error_rate = ber;
+            }
+        }
+
+        return best.bit_error_rate <= threshold;
+    }
+
+  private:
+    struct posting {
+        uint32_t fingerprint;
+        uint32_t track;
+        uint32_t window;
+
+        bool operator<(const posting& o) const {
+            return fingerprint != o.fingerprint ? fingerprint < o.fingerprint
+                   : track != o.track           ? track < o.track
+                                                : window < o.window;
+        }
+    };
+
+    static bool by_fingerprint(const posting& a, const posting& b) {
+        return a.fingerprint < b.fingerprint;
+    }
+
+    // Over the part of the query that overlaps the track
+    static float bit_error_rate(const std::vector<uint32_t>& track, int64_t offset,
+                                const uint32_t* fingerprints, size_t n) {
+        uint64_t errors = 0, bits = 0;
+
+        for (size_t i = 0; i < n; ++i) {
+            int64_t w = offset + int64_t(i);
+            if (w < 0 || w >= int64_t(track.size()))
+                continue;
+
+            uint32_t x = track[w] ^ fingerprints[i];
+            for (; x; x &= x - 1)
+                ++errors;
+            bits += 32;
+        }
+
+        return bits ? float(errors) / bits : 1;
+    }
+
+    size_t max_postings;
+    bool sorted = true;
+    std::vector<posting> postings;
+    std::vector<std::vector<uint32_t>> tracks;
+};
+
+} // namespace bluespy_codec_fingerprint
+
+#endif
@@ -31,7 +31,11 @@
 extern "C" {
 #endif
 
+#if defined __cplusplus && defined BLUESPY_CODEC_STATIC
+struct bluespy_codec_handle {}; // Base of each statically linked codec's handle
+#else
 struct bluespy_codec_handle;
+#endif
 
 enum BLUESPY_CODEC_TRANSPORT { BLUESPY_CODEC_A2DP = 1 };
 
@@ -130,12 +134,219 @@ BLUESPY_CODEC_API void bluespy_codec_deinit(bluespy_codec_handle* handle);
  *
  * This function decodes an on air frame of codec data and produces a frame of audio into an
  * external buffer. For A2DP, the coded_data will point to the start of the RTP header.
+ *
+ * Calling with coded_len == 0 marks the end of the stream (e.g. AVDTP suspend). Any samples still
+ * delayed inside the decoder are written out, and the handle is reset so the next call starts a
+ * fresh stream. Returns 0 if there was nothing left to flush.
  */
 BLUESPY_CODEC_API int bluespy_codec_decode(bluespy_codec_handle* handle, const uint8_t* coded_data,
                                            int coded_len, int16_t* uncoded_data, int uncoded_len);
 
+/* Optional exports. A plugin need not provide these, so hosts should look them up by name and
+ * carry on without them if they are missing. */
+
+/* Lets the host run any parallel work a plugin does on its own thread pool. Plugins never start
+ * threads of their own, so without an executor they do everything on the calling thread. */
+struct bluespy_codec_executor {
+    void* context; // Passed back to submit and wait
+    unsigned concurrency; // Tasks the host is willing to run at once for one call
+    // Queues fn(arg) to run on the host's pool, returning a task id for wait
+    uint64_t (*submit)(void* context, void (*fn)(void* arg), void* arg);
+    // Blocks until the task has finished. Each submitted task is waited for exactly once.
+    void (*wait)(void* context, uint64_t task);
+};
+
+/**
+ * @brief bluespy_codec_init_ex
+ * @param[in] executor Copied into the handle, so context must outlive it. May be null.
+ * @return As bluespy_codec_init
+ *
+ * As bluespy_codec_init, also giving the handle an executor for internal parallel work. Tasks are
+ * only submitted from within calls on the handle, and are all waited for before those return.
+ */
+BLUESPY_CODEC_API bluespy_codec_init_return
+bluespy_codec_init_ex(BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                      const void* codec_specific_data, int codec_specific_data_len,
+                      const bluespy_codec_executor* executor);
+
+#define BLUESPY_CODEC_MAX_SUBBANDS 8
+
+struct bluespy_codec_subbands {
+    unsigned channels;
+    unsigned bands; // Lowest frequency band first
+    // Mean energy of each subband over the last decoded packet, relative to full scale
+    float energy[2][BLUESPY_CODEC_MAX_SUBBANDS];
+    // Quantiser step size of each subband at the end of the last decoded packet
+    int32_t step_size[2][BLUESPY_CODEC_MAX_SUBBANDS];
+};
+
+/**
+ * @brief bluespy_codec_enable_subbands
+ * @param[in] handle
+ * @param[in] enable Non-zero to collect subband data from subsequent calls to bluespy_codec_decode
+ * @return BLUESPY_CODEC_SUCCESS, or BLUESPY_CODEC_UNSUPPORTED_CODEC if this stream has no subbands.
+ *
+ * For codecs that decode through a subband filterbank, this gathers a coarse spectral overview as a
+ * by-product of decoding. Collection is off by default.
+ */
+BLUESPY_CODEC_API BLUESPY_CODEC_ERRORS bluespy_codec_enable_subbands(bluespy_codec_handle* handle,
+                                                                      int enable);
+
+/**
+ * @brief bluespy_codec_get_subbands
+ * @param[in] handle
+ * @param[out] subbands Filled in from the most recently decoded packet
+ * @return BLUESPY_CODEC_SUCCESS, or BLUESPY_CODEC_UNSUPPORTED_CODEC if collection is not enabled.
+ */
+BLUESPY_CODEC_API BLUESPY_CODEC_ERRORS
+bluespy_codec_get_subbands(bluespy_codec_handle* handle, bluespy_codec_subbands* subbands);
+
+/* result is BLUESPY_CODEC_SUCCESS (0) for errors the packet still gave output through, i.e. frames
+ * the codec concealed, or data skipped after a loss of sync. bluespy_codec_decode then returned
+ * the packet's sample count rather than an error. */
+struct bluespy_codec_error_detail {
+    int32_t error;  // The codec library's own error code, or 0 if it gave none
+    int32_t result; // The BLUESPY_CODEC_ERRORS returned for the packet, see above
+    int32_t sequence_number; // RTP sequence number of the packet, or -1 if unknown
+    uint32_t byte_offset;    // Offset into coded_data at which decoding failed
+    uint32_t dropped_before; // Errors lost to a full log immediately before this one
+};
+
+/**
+ * @brief bluespy_codec_drain_errors
+ * @param[in] handle
+ * @param[out] errors
+ * @param[in] max_errors
+ * @return Number of entries written to errors, oldest first.
+ *
+ * Takes the details of recent decode failures from the handle's error log. This may be called from
+ * a different thread to bluespy_codec_decode, but only from one thread at a time.
+ */
+BLUESPY_CODEC_API int bluespy_codec_drain_errors(bluespy_codec_handle* handle,
+                                                 bluespy_codec_error_detail* errors,
+                                                 int max_errors);
+
+/**
+ * @brief bluespy_codec_enable_fingerprints
+ * @param[in] handle
+ * @param[in] enable Non-zero to fingerprint the output of subsequent calls to bluespy_codec_decode
+ * @return Spacing of the fingerprint windows in samples per channel, 0 when disabled, or a negative
+ * BLUESPY_CODEC_ERRORS.
+ *
+ * Fingerprints identify the audio content of a stream, so captures of the same material can be
+ * lined up (see bluespy_codec_fingerprint.hpp). Window i starts i * spacing samples per channel
+ * after the first sample decoded once enabled. The spacing is 10 ms at every sample rate, so
+ * streams at different rates can be matched against each other.
+ */
+BLUESPY_CODEC_API int bluespy_codec_enable_fingerprints(bluespy_codec_handle* handle, int enable);
+
+/**
+ * @brief bluespy_codec_drain_fingerprints
+ * @param[in] handle
+ * @param[out] fingerprints One 32 bit fingerprint per window
+ * @param[in] max_fingerprints
+ * @param[out] first_window Window index of fingerprints[0]
+ * @return Number of fingerprints written, or a negative BLUESPY_CODEC_ERRORS.
+ *
+ * Must not be called at the same time as bluespy_codec_decode on the same handle.
+ */
+BLUESPY_CODEC_API int bluespy_codec_drain_fingerprints(bluespy_codec_handle* handle,
+                                                       uint32_t* fingerprints,
+                                                       int max_fingerprints,
+                                                       uint64_t* first_window);
+
 #ifdef __cplusplus
 }
 #endif
 
+#ifdef __cplusplus
+namespace bluespy_codec_static {
+
+// The optional exports of a statically linked codec, each nullptr if the codec does not define it
+struct optional_exports {
+    BLUESPY_CODEC_ERRORS (*enable_subbands)(bluespy_codec_handle*, int);
+    BLUESPY_CODEC_ERRORS (*get_subbands)(bluespy_codec_handle*, bluespy_codec_subbands*);
+    int (*drain_errors)(bluespy_codec_handle*, bluespy_codec_error_detail*, int);
+    int (*enable_fingerprints)(bluespy_codec_handle*, int);
+    int (*drain_fingerprints)(bluespy_codec_handle*, uint32_t*, int, uint64_t*);
+};
+
+} // namespace bluespy_codec_static
+#endif
+
+/* Static embedding (see bluespy_codec_static.hpp). When a codec is compiled with
+ * BLUESPY_CODEC_STATIC defined, these macros move its definitions into
+ * namespace bluespy_codec_static::<name> instead of exporting the C symbols, so several codecs can
+ * be linked into one binary. Wrap the body of the codec source with them. */
+#if defined __cplusplus && defined BLUESPY_CODEC_STATIC
+#include <cstddef>
+
+namespace bluespy_codec_static {
+namespace detail {
+
+struct absent {};
+
+// Adapts f, which takes the codec's own handle type, to take the base handle
+template <class F, F f> struct base_handle;
+template <class Handle, class R, class... Args, R (*f)(Handle*, Args...)>
+struct base_handle<R (*)(Handle*, Args...), f> {
+    static R call(::bluespy_codec_handle* handle, Args... args) {
+        return f(static_cast<Handle*>(handle), args...);
+    }
+};
+
+} // namespace detail
+} // namespace bluespy_codec_static
+
+// Finds the codec's own definition of an optional export, if any. The placeholder overload keeps
+// lookup from reaching the C declaration above, so <export>_static<Handle>(0) is either the
+// adapted function or nullptr.
+#define BLUESPY_CODEC_STATIC_OPTIONAL(R, export, ...)                                              \
+    template <class T = void>                                                                      \
+    ::bluespy_codec_static::detail::absent export(::bluespy_codec_static::detail::absent,          \
+                                                  T*);                                             \
+    template <class Handle>                                                                        \
+    auto export##_static(int) -> decltype(&::bluespy_codec_static::detail::base_handle<           \
+                                          R (*)(Handle*, __VA_ARGS__), &export>::call) {           \
+        return &::bluespy_codec_static::detail::base_handle<R (*)(Handle*, __VA_ARGS__),           \
+                                                            &export>::call;                        \
+    }                                                                                              \
+    template <class Handle> std::nullptr_t export##_static(...) { return nullptr; }
+
+#define BLUESPY_CODEC_NAMESPACE_BEGIN(name)                                                        \
+    namespace bluespy_codec_static {                                                               \
+    namespace name {
+#define BLUESPY_CODEC_HANDLE_BASE : ::bluespy_codec_handle
+#define BLUESPY_CODEC_NAMESPACE_END                                                                \
+    void bluespy_codec_deinit_static(::bluespy_codec_handle* handle) {                             \
+        bluespy_codec_deinit(static_cast<bluespy_codec_handle*>(handle));                          \
+    }                                                                                              \
+    int bluespy_codec_decode_static(::bluespy_codec_handle* handle, const uint8_t* coded_data,     \
+                                    int coded_len, int16_t* uncoded_data, int uncoded_len) {       \
+        return bluespy_codec_decode(static_cast<bluespy_codec_handle*>(handle), coded_data,        \
+                                    coded_len, uncoded_data, uncoded_len);                         \
+    }                                                                                              \
+    BLUESPY_CODEC_STATIC_OPTIONAL(BLUESPY_CODEC_ERRORS, bluespy_codec_enable_subbands, int)        \
+    BLUESPY_CODEC_STATIC_OPTIONAL(BLUESPY_CODEC_ERRORS, bluespy_codec_get_subbands,                \
+                                  bluespy_codec_subbands*)                                         \
+    BLUESPY_CODEC_STATIC_OPTIONAL(int, bluespy_codec_drain_errors, bluespy_codec_error_detail*,    \
+                                  int)                                                             \
+    BLUESPY_CODEC_STATIC_OPTIONAL(int, bluespy_codec_enable_fingerprints, int)                     \
+    BLUESPY_CODEC_STATIC_OPTIONAL(int, bluespy_codec_drain_fingerprints, uint32_t*, int,           \
+                                  uint64_t*)                                                       \
+    extern const ::bluespy_codec_static::optional_exports bluespy_codec_optional_static = {        \
+        bluespy_codec_enable_subbands_static<bluespy_codec_handle>(0),                             \
+        bluespy_codec_get_subbands_static<bluespy_codec_handle>(0),                                \
+        bluespy_codec_drain_errors_static<bluespy_codec_handle>(0),                                \
+        bluespy_codec_enable_fingerprints_static<bluespy_codec_handle>(0),                         \
+        bluespy_codec_drain_fingerprints_static<bluespy_codec_handle>(0),                          \
+    };                                                                                             \
+    }                                                                                              \
+    }
+#else
+#define BLUESPY_CODEC_NAMESPACE_BEGIN(name)
+#define BLUESPY_CODEC_HANDLE_BASE
+#define BLUESPY_CODEC_NAMESPACE_END
+#endif
+
 #endif
\ No newline at end of file
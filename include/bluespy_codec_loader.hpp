@@ -0,0 +1,418 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_LOADER_HPP
+#define BLUESPY_CODEC_LOADER_HPP
+
+// Host-side helper for choosing plugins from the .manifest files written next to them at build
+// time. Manifests are read at startup, and a plugin library is only loaded the first time a stream
+// it handles is initialised.
+
+#include "bluespy_codec_interface.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <dlfcn.h>
+#endif
+
+namespace bluespy_codec_loader {
+
+struct codec_id {
+    int transport;
+    int media_codec_type;
+    bool vendor_specific; // Only for BLUESPY_CODEC_A2DP_Non_A2DP
+    uint32_t vendor;
+    uint16_t codec_id;
+};
+
+struct manifest {
+    int abi_version = 0;
+    std::string codec_name;
+    std::string library; // Full path, resolved against the manifest's directory
+    std::string sha256; // Of the library, lower case hex, empty if not given
+    std::vector<codec_id> codecs;
+};
+
+namespace detail {
+
+// Minimal SHA-256 (FIPS 180-4), only for checking libraries against their manifests
+class sha256 {
+  public:
+    void update(const uint8_t* data, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            block[used++] = data[i];
+            if (used == 64) {
+                compress();
+                used = 0;
+            }
+        }
+        length += len;
+    }
+
+    std::string hex() {
+        uint64_t bits = length * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (used != 56)
+            update(&pad, 1);
+        for (int i = 7; i >= 0; --i) {
+            uint8_t b = uint8_t(bits >> (8 * i));
+            update(&b, 1);
+        }
+
+        static const char digits[] = "0123456789abcdef";
+        std::string out;
+        for (uint32_t word : h)
+            for (int i = 28; i >= 0; i -= 4)
+                out += digits[word >> i & 0xF];
+        return out;
+    }
+
+  private:
+    static uint32_t rotr(uint32_t x, int n) { return x >> n | x << (32 - n); }
+
+    void compress() {
+        static const uint32_t k[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4,
+            0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe,
+            0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f,
+            0x4a7484aa, 0x5cb0a9dc, 0x76f988da, 0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+            0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc,
+            0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+            0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070, 0x19a4c116,
+            0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7,
+            0xc67178f2};
+
+        uint32_t w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = uint32_t(block[4 * i]) << 24 | block[4 * i + 1] << 16 | block[4 * i + 2] << 8 |
+                   block[4 * i + 3];
+        for (int i = 16; i < 64; ++i)
+            w[i] = w[i - 16] + (rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ w[i - 15] >> 3) +
+                   w[i - 7] + (rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ w[i - 2] >> 10);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+        for (int i = 0; i < 64; ++i) {
+            uint32_t t1 =
+                hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + k[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+
+    uint32_t h[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                     0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+    uint8_t block[64];
+    size_t used = 0;
+    uint64_t length = 0;
+};
+
+} // namespace detail
+
+/**
+ * @brief file_sha256
+ * @param[in] path
+ * @return Lower case hex SHA-256 of the file's contents, or empty if it could not be read
+ */
+inline std::string file_sha256(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return std::string();
+
+    detail::sha256 hash;
+    char buffer[1 << 16];
+    while (in.read(buffer, sizeof(buffer)) || in.gcount())
+        hash.update((const uint8_t*)buffer, (size_t)in.gcount());
+
+    return hash.hex();
+}
+
+/**
+ * @brief read_manifest
+ * @param[in] path
+ * @param[out] m
+ * @return false if the file could not be read or is not a manifest
+ */
+inline bool read_manifest(const std::string& path, manifest& m) {
+    std::ifstream in(path);
+    if (!in)
+        return false;
+
+    m = manifest();
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+
+        auto eq = line.find('=');
+        if (line.empty() || line[0] == '#' || eq == std::string::npos)
+            continue;
+
+        std::string key = line.substr(0, eq), value = line.substr(eq + 1);
+
+        if (key == "abi_version") {
+            m.abi_version = std::atoi(value.c_str());
+        } else if (key == "codec_name") {
+            m.codec_name = value;
+        } else if (key == "library") {
+            auto slash = path.find_last_of("/\\");
+            m.library = slash == std::string::npos ? value : path.substr(0, slash + 1) + value;
+        } else if (key == "sha256") {
+            for (char& c : value)
+                c = (char)std::tolower((unsigned char)c);
+            m.sha256 = value;
+        } else if (key == "codec") {
+            codec_id id{};
+            char* end;
+            id.transport = std::strtol(value.c_str(), &end, 10);
+            if (*end != ':')
+                return false;
+            id.media_codec_type = std::strtol(end + 1, &end, 10);
+            if (*end == ':') {
+                id.vendor_specific = true;
+                id.vendor = std::strtoul(end + 1, &end, 16);
+                if (*end != ':')
+                    return false;
+                id.codec_id = (uint16_t)std::strtoul(end + 1, &end, 16);
+            }
+            m.codecs.push_back(id);
+        }
+    }
+
+    return m.abi_version != 0 && !m.library.empty();
+}
+
+/**
+ * @brief handles
+ * @return true if the manifest lists the codec that bluespy_codec_init would be given
+ *
+ * For vendor specific A2DP codecs, codec_specific_data starts with the little endian vendor and
+ * codec IDs, as in aptx.cpp.
+ */
+inline bool handles(const manifest& m, BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                    const void* codec_specific_data, int codec_specific_data_len) {
+    for (const auto& id : m.codecs) {
+        if (id.transport != transport || id.media_codec_type != media_codec_type)
+            continue;
+
+        if (!id.vendor_specific)
+            return true;
+
+        if (codec_specific_data_len < 6)
+            continue;
+
+        const uint8_t* data = (const uint8_t*)codec_specific_data;
+        uint32_t vendor = data[0] | data[1] << 8 | data[2] << 16 | (uint32_t)data[3] << 24;
+        uint16_t codec = data[4] | data[5] << 8;
+
+        if (vendor == id.vendor && codec == id.codec_id)
+            return true;
+    }
+
+    return false;
+}
+
+// A plugin library, loaded on first use
+class plugin {
+  public:
+    explicit plugin(manifest m) : m(std::move(m)) {}
+    plugin(const plugin&) = delete;
+    plugin& operator=(const plugin&) = delete;
+    ~plugin() { unload(); }
+
+    const manifest& info() const { return m; }
+    bool loaded() const { return library != nullptr; }
+
+    /**
+     * @brief verify
+     * @return true if the library matches the manifest's sha256, or the manifest gives none
+     */
+    bool verify() const { return m.sha256.empty() || file_sha256(m.library) == m.sha256; }
+
+    /**
+     * @brief load
+     * @return false if the library is missing, has been replaced since its manifest was written,
+     * or does not export the plugin interface. A failed load is not retried.
+     */
+    bool load() {
+        if (library)
+            return true;
+
+        // Only tried once, so a bad library is not hashed and opened again for every stream
+        if (failed)
+            return false;
+        failed = true;
+
+        if (!verify())
+            return false;
+
+#ifdef _WIN32
+        library = LoadLibraryA(m.library.c_str());
+#else
+        library = dlopen(m.library.c_str(), RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (!library)
+            return false;
+
+        init = (decltype(init))symbol("bluespy_codec_init");
+        deinit = (decltype(deinit))symbol("bluespy_codec_deinit");
+        decode = (decltype(decode))symbol("bluespy_codec_decode");
+        init_ex = (decltype(init_ex))symbol("bluespy_codec_init_ex"); // Optional
+
+        if (!init || !deinit || !decode) {
+            unload();
+            return false;
+        }
+
+        failed = false;
+        return true;
+    }
+
+    bluespy_codec_init_return (*init)(BLUESPY_CODEC_TRANSPORT, int, const void*, int) = nullptr;
+    bluespy_codec_init_return (*init_ex)(BLUESPY_CODEC_TRANSPORT, int, const void*, int,
+                                         const bluespy_codec_executor*) = nullptr;
+    void (*deinit)(bluespy_codec_handle*) = nullptr;
+    int (*decode)(bluespy_codec_handle*, const uint8_t*, int, int16_t*, int) = nullptr;
+
+  private:
+    void unload() {
+        if (library) {
+#ifdef _WIN32
+            FreeLibrary((HMODULE)library);
+#else
+            dlclose(library);
+#endif
+        }
+        library = nullptr;
+        init = nullptr;
+        init_ex = nullptr;
+        deinit = nullptr;
+        decode = nullptr;
+    }
+
+    void* symbol(const char* name) {
+#ifdef _WIN32
+        return (void*)GetProcAddress((HMODULE)library, name);
+#else
+        return dlsym(library, name);
+#endif
+    }
+
+    manifest m;
+    void* library = nullptr;
+    bool failed = false; // load() was tried and did not succeed
+};
+
+class registry {
+  public:
+    /**
+     * @brief add_directory
+     * @param[in] dir One of the codec directories listed in README.md
+     * @return Number of manifests read
+     */
+    int add_directory(const std::string& dir) {
+        int n = 0;
+#ifdef _WIN32
+        WIN32_FIND_DATAA found;
+        HANDLE h = FindFirstFileA((dir + "\\*.manifest").c_str(), &found);
+        if (h == INVALID_HANDLE_VALUE)
+            return 0;
+        do {
+            n += add_manifest(dir + "\\" + found.cFileName);
+        } while (FindNextFileA(h, &found));
+        FindClose(h);
+#else
+        DIR* d = opendir(dir.c_str());
+        if (!d)
+            return 0;
+        while (dirent* e = readdir(d)) {
+            size_t len = std::strlen(e->d_name);
+            if (len > 9 && std::strcmp(e->d_name + len - 9, ".manifest") == 0)
+                n += add_manifest(dir + "/" + e->d_name);
+        }
+        closedir(d);
+#endif
+        return n;
+    }
+
+    bool add_manifest(const std::string& path) {
+        manifest m;
+        if (!read_manifest(path, m) || m.abi_version != 1)
+            return false;
+
+        plugins.emplace_back(new plugin(std::move(m)));
+        return true;
+    }
+
+    /**
+     * @brief init
+     * @param[out] selected The plugin whose handle was returned
+     * @param[in] executor Given to plugins that export bluespy_codec_init_ex
+     * @return As bluespy_codec_init, from the first listed plugin to accept the configuration.
+     *
+     * Only plugins whose manifest lists the codec are loaded and asked.
+     */
+    bluespy_codec_init_return init(BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                                   const void* codec_specific_data, int codec_specific_data_len,
+                                   plugin** selected,
+                                   const bluespy_codec_executor* executor = nullptr) {
+        bluespy_codec_init_return r{BLUESPY_CODEC_UNSUPPORTED_CODEC};
+
+        for (auto& p : plugins) {
+            if (!handles(p->info(), transport, media_codec_type, codec_specific_data,
+                         codec_specific_data_len) ||
+                !p->load())
+                continue;
+
+            r = p->init_ex ? p->init_ex(transport, media_codec_type, codec_specific_data,
+                                        codec_specific_data_len, executor)
+                           : p->init(transport, media_codec_type, codec_specific_data,
+                                     codec_specific_data_len);
+            if (r.result == BLUESPY_CODEC_SUCCESS) {
+                *selected = p.get();
+                break;
+            }
+        }
+
+        return r;
+    }
+
+    const std::vector<std::unique_ptr<plugin>>& all() const { return plugins; }
+
+  private:
+    std::vector<std::unique_ptr<plugin>> plugins;
+};
+
+} // namespace bluespy_codec_loader
+
+#endif
@@ -0,0 +1,105 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#ifndef BLUESPY_CODEC_STATIC_HPP
+#define BLUESPY_CODEC_STATIC_HPP
+
+// Front end for codecs linked statically (cmake -DBLUESPY_CODECS_STATIC=ON). Link against
+// bluespy_codecs_static; each codec in it defines BLUESPY_CODEC_STATIC_<NAME> for its users. Hosts
+// can then either search the constexpr registry below, as they would the plugin directory, or call
+// a known codec's functions directly, e.g. bluespy_codec_static::aac::bluespy_codec_decode_static.
+// The optional exports are reached through each entry's optional table, whose slots are nullptr for
+// those the codec does not define.
+
+#include "bluespy_codec_interface.h"
+
+#define BLUESPY_CODEC_STATIC_DECLARE(name)                                                         \
+    namespace bluespy_codec_static {                                                               \
+    namespace name {                                                                               \
+    bluespy_codec_info_return bluespy_codec_info();                                                \
+    bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,                \
+                                                 int media_codec_type,                             \
+                                                 const void* codec_specific_data,                  \
+                                                 int codec_specific_data_len);                     \
+    bluespy_codec_init_return bluespy_codec_init_ex(                                               \
+        BLUESPY_CODEC_TRANSPORT transport, int media_codec_type, const void* codec_specific_data,  \
+        int codec_specific_data_len, const bluespy_codec_executor* executor);                      \
+    void bluespy_codec_deinit_static(::bluespy_codec_handle* handle);                              \
+    int bluespy_codec_decode_static(::bluespy_codec_handle* handle, const uint8_t* coded_data,     \
+                                    int coded_len, int16_t* uncoded_data, int uncoded_len);        \
+    extern const optional_exports bluespy_codec_optional_static;                                   \
+    }                                                                                              \
+    }
+
+#define BLUESPY_CODEC_STATIC_ENTRY(name)                                                           \
+    {                                                                                              \
+        #name, &name::bluespy_codec_info, &name::bluespy_codec_init, &name::bluespy_codec_init_ex, \
+            &name::bluespy_codec_deinit_static, &name::bluespy_codec_decode_static,                \
+            &name::bluespy_codec_optional_static                                                   \
+    }
+
+#ifdef BLUESPY_CODEC_STATIC_AAC
+BLUESPY_CODEC_STATIC_DECLARE(aac)
+#endif
+#ifdef BLUESPY_CODEC_STATIC_APTX
+BLUESPY_CODEC_STATIC_DECLARE(aptx)
+#endif
+#ifdef BLUESPY_CODEC_STATIC_LC3PLUS
+BLUESPY_CODEC_STATIC_DECLARE(lc3plus)
+#endif
+
+namespace bluespy_codec_static {
+
+struct codec {
+    const char* name; // nullptr marks the end of the registry
+    bluespy_codec_info_return (*info)();
+    bluespy_codec_init_return (*init)(BLUESPY_CODEC_TRANSPORT, int, const void*, int);
+    bluespy_codec_init_return (*init_ex)(BLUESPY_CODEC_TRANSPORT, int, const void*, int,
+                                         const bluespy_codec_executor*);
+    void (*deinit)(bluespy_codec_handle*);
+    int (*decode)(bluespy_codec_handle*, const uint8_t*, int, int16_t*, int);
+    const optional_exports* optional; // Slots are nullptr for exports the codec does not define
+};
+
+constexpr codec registry[] = {
+#ifdef BLUESPY_CODEC_STATIC_AAC
+    BLUESPY_CODEC_STATIC_ENTRY(aac),
+#endif
+#ifdef BLUESPY_CODEC_STATIC_APTX
+    BLUESPY_CODEC_STATIC_ENTRY(aptx),
+#endif
+#ifdef BLUESPY_CODEC_STATIC_LC3PLUS
+    BLUESPY_CODEC_STATIC_ENTRY(lc3plus),
+#endif
+    {nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr},
+};
+
+/**
+ * @brief init
+ * @param[out] selected The registry entry whose handle was returned
+ * @param[in] executor For the codec's internal parallel work, see bluespy_codec_init_ex
+ * @return The result of the first codec to accept the configuration, as bluespy_codec_init.
+ *
+ * Offers the configuration to each linked codec in turn, the same way the host tries every plugin.
+ */
+inline bluespy_codec_init_return init(BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                                      const void* codec_specific_data, int codec_specific_data_len,
+                                      const codec** selected,
+                                      const bluespy_codec_executor* executor = nullptr) {
+    bluespy_codec_init_return r{BLUESPY_CODEC_UNSUPPORTED_CODEC};
+
+    for (const codec* c = registry; c->name; ++c) {
+        r = c->init_ex(transport, media_codec_type, codec_specific_data, codec_specific_data_len,
+                       executor);
+        if (r.result == BLUESPY_CODEC_SUCCESS) {
+            *selected = c;
+            break;
+        }
+    }
+
+    return r;
+}
+
+} // namespace bluespy_codec_static
+
+#endif
@@ -0,0 +1,271 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+#include "bluespy_codec_interface.h"
+#include "bluespy_codec_decode_export.h"
+#include "bluespy_codec_error_ring.h"
+#include "bluespy_codec_fingerprint.h"
+#include "bluespy_codec_probes.h"
+#include "lc3plus_codec_ids.h" // Generated from the manifest entries in CMakeLists.txt
+
+extern "C" {
+#include "lc3plus.h"
+}
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+BLUESPY_CODEC_NAMESPACE_BEGIN(lc3plus)
+
+bluespy_codec_info_return bluespy_codec_info() { return {1, "LC3plus"}; }
+
+// Each RTP payload starts with a one byte header. Up to 15 whole frames of equal size follow it,
+// or one fragment of a frame too large for a single packet.
+const uint8_t PAYLOAD_FRAGMENTED = 0x80;
+const uint8_t PAYLOAD_FIRST_FRAGMENT = 0x40;
+const uint8_t PAYLOAD_LAST_FRAGMENT = 0x20;
+const uint8_t PAYLOAD_FRAME_COUNT = 0x0F;
+
+struct bluespy_codec_handle BLUESPY_CODEC_HANDLE_BASE {
+    LC3PLUS_Dec* lc3plus = nullptr;
+    int frame_dms = 0; // Frame duration in tenths of a millisecond
+    unsigned sample_rate = 0, channels = 0;
+    int frame_samples = 0; // Per channel
+    int32_t sequence_number = -1;
+    bool decoded = false; // Since the decoder was last initialised
+    std::vector<uint8_t> scratch;
+    std::vector<int16_t> planar;
+    std::vector<uint8_t> fragments; // Of the frame being reassembled
+    int32_t fragment_sequence_number = -1; // Of the last fragment added, -1 if none pending
+    bluespy_codec_error_ring<64> errors;
+    std::unique_ptr<bluespy_codec_fingerprinter> fingerprints; // Set while fingerprinting
+
+    bluespy_codec_handle(unsigned sample_rate, unsigned channels, int frame_dms)
+        : lc3plus((LC3PLUS_Dec*)calloc(1, lc3plus_dec_get_size(sample_rate, channels,
+                                                               LC3PLUS_PLC_ADVANCED))),
+          frame_dms(frame_dms), sample_rate(sample_rate), channels(channels) {}
+    bluespy_codec_handle(const bluespy_codec_handle&) = delete;
+    bluespy_codec_handle& operator=(const bluespy_codec_handle&) = delete;
+    ~bluespy_codec_handle() { free(lc3plus); }
+
+    bool reset() {
+        decoded = false;
+        fragment_sequence_number = -1;
+
+        if (lc3plus_dec_init(lc3plus, sample_rate, channels, LC3PLUS_PLC_ADVANCED, 1) !=
+                LC3PLUS_OK ||
+            lc3plus_dec_set_frame_dms(lc3plus, frame_dms) != LC3PLUS_OK)
+            return false;
+
+        frame_samples = lc3plus_dec_get_output_samples(lc3plus);
+        scratch.resize(lc3plus_dec_get_scratch_size(lc3plus));
+        planar.resize(frame_samples * channels);
+        return true;
+    }
+};
+
+static bluespy_codec_init_return init(BLUESPY_CODEC_TRANSPORT transport, int media_codec_type,
+                                      const void* codec_specific_data,
+                                      int codec_specific_data_len) {
+    bluespy_codec_init_return r{BLUESPY_CODEC_UNSUPPORTED_CODEC};
+
+    if (transport != BLUESPY_CODEC_A2DP || media_codec_type != BLUESPY_CODEC_A2DP_Non_A2DP ||
+        codec_specific_data_len < 10)
+        return r;
+
+    uint32_t vendor;
+    uint16_t codec_id;
+    memcpy(&vendor, codec_specific_data, 4);
+    memcpy(&codec_id, (const char*)codec_specific_data + 4, 2);
+
+    if (vendor != LC3PLUS_HR_VENDOR || codec_id != LC3PLUS_HR_CODEC_ID)
+        return r;
+
+    r.codec_name = "LC3plus HR";
+
+    const uint8_t* codec_info = (const uint8_t*)codec_specific_data + 6;
+    int frame_dms;
+
+    switch (codec_info[0] & 0xF0) {
+    case 0x40:
+        frame_dms = 100;
+        break;
+    case 0x20:
+        frame_dms = 50;
+        break;
+    case 0x10:
+        frame_dms = 25;
+        break;
+    default:
+        return r;
+    }
+
+    switch (codec_info[1]) {
+    case 0x80:
+        r.channels = 1;
+        break;
+    case 0x40:
+        r.channels = 2;
+        break;
+    default:
+        return r;
+    }
+
+    switch (codec_info[2] << 8 | codec_info[3]) { // Big endian, unlike the IDs
+    case 0x100:
+        r.sample_rate = 48000;
+        break;
+    case 0x80:
+        r.sample_rate = 96000;
+        break;
+    default:
+        return r;
+    }
+
+    auto handle = new bluespy_codec_handle{r.sample_rate, r.channels, frame_dms};
+
+    if (!handle->lc3plus || !handle->reset()) {
+        delete handle;
+        r.result = BLUESPY_CODEC_UNRECOVERABLE_ERROR;
+        return r;
+    }
+
+    r.handle = handle;
+    r.result = BLUESPY_CODEC_SUCCESS;
+    r.seek_pre_frames = 1;
+    // The payload header limits a packet to 15 frames, so size for that whatever the bitrate
+    r.min_output_size = 15 * handle->frame_samples * r.channels;
+    r.min_bitrate = 0xFFFFFFFF;
+
+    return r;
+}
+
+bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
+                                             int media_codec_type, const void* codec_specific_data,
+                                             int codec_specific_data_len) {
+    return init(transport, media_codec_type, codec_specific_data, codec_specific_data_len);
+}
+
+// Decoding is serial, so there is nothing to give the executor
+bluespy_codec_init_return bluespy_codec_init_ex(BLUESPY_CODEC_TRANSPORT transport,
+                                                int media_codec_type,
+                                                const void* codec_specific_data,
+                                                int codec_specific_data_len,
+                                                const bluespy_codec_executor*) {
+    return init(transport, media_codec_type, codec_specific_data, codec_specific_data_len);
+}
+
+void bluespy_codec_deinit(bluespy_codec_handle* handle) { delete handle; }
+
+// Decodes one frame to the end of uncoded_data, returning the samples written or an error. A frame
+// that fails to decode is concealed by the library, so still produces output.
+static int decode_frame(bluespy_codec_handle* handle, const uint8_t* frame, int frame_len,
+                        int16_t* uncoded_data, int byte_offset) {
+    int16_t* planes[2] = {handle->planar.data(), handle->planar.data() + handle->frame_samples};
+
+    LC3PLUS_Error err = lc3plus_dec16(handle->lc3plus, (void*)frame, frame_len, planes,
+                                      handle->scratch.data(), 0);
+    handle->decoded = true;
+
+    if (err == LC3PLUS_DECODE_ERROR) {
+        handle->errors.push(err, BLUESPY_CODEC_SUCCESS, handle->sequence_number, byte_offset);
+    } else if (err != LC3PLUS_OK) {
+        handle->errors.push(err, BLUESPY_CODEC_RECOVERABLE_ERROR, handle->sequence_number,
+                            byte_offset);
+        return BLUESPY_CODEC_RECOVERABLE_ERROR;
+    }
+
+    for (int i = 0; i < handle->frame_samples; ++i)
+        for (unsigned c = 0; c < handle->channels; ++c)
+            uncoded_data[i * handle->channels + c] = planes[c][i];
+
+    int samples = handle->frame_samples * handle->channels;
+    BLUESPY_CODEC_PROBE3(frame, handle, handle->sequence_number, samples);
+
+    return samples;
+}
+
+static int decode(bluespy_codec_handle* handle, const uint8_t* coded_data, int coded_len,
+                  int16_t* uncoded_data, int uncoded_len) {
+    handle->sequence_number = -1;
+
+    if (coded_len <= 0) { // End of stream, LC3plus has no tail to flush so just reinitialise
+        if (handle->decoded && !handle->reset())
+            return BLUESPY_CODEC_UNRECOVERABLE_ERROR;
+        return 0;
+    }
+
+    // Remove RTP and payload headers
+    int rtp_header_len = 12 + 4 * (*coded_data & 0xF);
+
+    if (coded_len <= rtp_header_len) {
+        handle->errors.push(0, BLUESPY_CODEC_RECOVERABLE_ERROR, -1, 0);
+        return BLUESPY_CODEC_RECOVERABLE_ERROR;
+    }
+
+    handle->sequence_number = (uint16_t)coded_data[2] << 8 | coded_data[3];
+
+    uint8_t payload_header = coded_data[rtp_header_len];
+    const uint8_t* payload = coded_data + rtp_header_len + 1;
+    int payload_len = coded_len - rtp_header_len - 1;
+    int frame_output = handle->frame_samples * handle->channels;
+
+    if (payload_header & PAYLOAD_FRAGMENTED) {
+        if (uncoded_len < frame_output)
+            return BLUESPY_CODEC_BUFFER_TOO_SMALL;
+
+        if (payload_header & PAYLOAD_FIRST_FRAGMENT) {
+            handle->fragments.clear();
+        } else if (handle->fragment_sequence_number < 0 ||
+                   (uint16_t)(handle->fragment_sequence_number + 1) != handle->sequence_number) {
+            // Lost the start of this frame, wait for the next
+            handle->fragment_sequence_number = -1;
+            handle->errors.push(0, BLUESPY_CODEC_RECOVERABLE_ERROR, handle->sequence_number,
+                                rtp_header_len);
+            return BLUESPY_CODEC_RECOVERABLE_ERROR;
+        }
+
+        handle->fragments.insert(handle->fragments.end(), payload, payload + payload_len);
+        handle->fragment_sequence_number = handle->sequence_number;
+
+        if (!(payload_header & PAYLOAD_LAST_FRAGMENT))
+            return 0;
+
+        handle->fragment_sequence_number = -1;
+        return decode_frame(handle, handle->fragments.data(), (int)handle->fragments.size(),
+                            uncoded_data, rtp_header_len + 1);
+    }
+
+    int frames = payload_header & PAYLOAD_FRAME_COUNT;
+
+    if (frames == 0 || payload_len % frames) {
+        handle->errors.push(0, BLUESPY_CODEC_RECOVERABLE_ERROR, handle->sequence_number,
+                            rtp_header_len);
+        return BLUESPY_CODEC_RECOVERABLE_ERROR;
+    }
+
+    if (uncoded_len < frames * frame_output)
+        return BLUESPY_CODEC_BUFFER_TOO_SMALL;
+
+    int coded_frame_len = payload_len / frames;
+    int written = 0;
+
+    for (int f = 0; f < frames; ++f) {
+        int r = decode_frame(handle, payload + f * coded_frame_len, coded_frame_len,
+                             uncoded_data + written, rtp_header_len + 1 + f * coded_frame_len);
+        if (r < 0)
+            return r;
+        written += r;
+    }
+
+    return written;
+}
+
+BLUESPY_CODEC_DECODE_EXPORT(decode)
+
+BLUESPY_CODEC_ERROR_RING_EXPORTS
+
+BLUESPY_CODEC_FINGERPRINT_EXPORTS
+
+BLUESPY_CODEC_NAMESPACE_END
@@ -0,0 +1,467 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Python bindings for any plugin built against bluespy_codec_interface.h. Packets are read and PCM
+// written through the buffer protocol, so numpy arrays and bytes are used without copying, and the
+// GIL is released while decoding so streams can be decoded from several threads at once.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "bluespy_codec_interface.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace {
+
+typedef bluespy_codec_info_return (*info_fn)();
+typedef bluespy_codec_init_return (*init_fn)(BLUESPY_CODEC_TRANSPORT, int, const void*, int);
+typedef bluespy_codec_init_return (*init_ex_fn)(BLUESPY_CODEC_TRANSPORT, int, const void*, int,
+                                                const bluespy_codec_executor*);
+typedef void (*deinit_fn)(bluespy_codec_handle*);
+typedef int (*decode_fn)(bluespy_codec_handle*, const uint8_t*, int, int16_t*, int);
+
+struct Plugin {
+    PyObject_HEAD
+    void* library;
+    info_fn info;
+    init_fn init;
+    init_ex_fn init_ex; // Optional
+    deinit_fn deinit;
+    decode_fn decode;
+};
+
+struct Decoder {
+    PyObject_HEAD
+    Plugin* plugin;
+    bluespy_codec_handle* handle;
+    bluespy_codec_init_return config;
+    bool busy; // Only one thread may decode on a handle at a time
+};
+
+void* load_library(const char* path) {
+#ifdef _WIN32
+    return LoadLibraryA(path);
+#else
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+void* load_symbol(void* library, const char* name) {
+#ifdef _WIN32
+    return (void*)GetProcAddress((HMODULE)library, name);
+#else
+    return dlsym(library, name);
+#endif
+}
+
+void free_library(void* library) {
+#ifdef _WIN32
+    FreeLibrary((HMODULE)library);
+#else
+    dlclose(library);
+#endif
+}
+
+// True for a signed integer buffer of the given width, whichever format code the exporter chose
+bool is_signed_int(const Py_buffer& b, Py_ssize_t size) {
+    if (b.itemsize != size || !b.format)
+        return false;
+
+    const char* f = b.format;
+    if (*f == '<' || *f == '@' || *f == '=')
+        ++f;
+
+    return f[0] && !f[1] && strchr("bhilq", f[0]);
+}
+
+// Executor for bluespy_codec_init_ex, running each task on a thread of its own. Plugins only
+// submit tasks from within decode calls, which have released the GIL.
+uint64_t executor_submit(void*, void (*fn)(void*), void* arg) {
+    return (uint64_t)(uintptr_t) new std::thread(fn, arg);
+}
+
+void executor_wait(void*, uint64_t task) {
+    auto thread = (std::thread*)(uintptr_t)task;
+    thread->join();
+    delete thread;
+}
+
+// Plugin
+
+int Plugin_init(Plugin* self, PyObject* args, PyObject*) {
+    // Decoders opened from the plugin hold handles into its library, so it cannot be swapped
+    if (self->library) {
+        PyErr_SetString(PyExc_RuntimeError, "Plugin is already initialised");
+        return -1;
+    }
+
+    PyObject* path_obj;
+    if (!PyArg_ParseTuple(args, "O&", PyUnicode_FSConverter, &path_obj))
+        return -1;
+
+    void* library = load_library(PyBytes_AS_STRING(path_obj));
+    Py_DECREF(path_obj);
+
+    if (!library) {
+        PyErr_SetString(PyExc_OSError, "Could not load codec plugin");
+        return -1;
+    }
+
+    self->info = (info_fn)load_symbol(library, "bluespy_codec_info");
+    self->init = (init_fn)load_symbol(library, "bluespy_codec_init");
+    self->init_ex = (init_ex_fn)load_symbol(library, "bluespy_codec_init_ex");
+    self->deinit = (deinit_fn)load_symbol(library, "bluespy_codec_deinit");
+    self->decode = (decode_fn)load_symbol(library, "bluespy_codec_decode");
+
+    if (!self->info || !self->init || !self->deinit || !self->decode) {
+        free_library(library);
+        PyErr_SetString(PyExc_OSError, "Library is not a bluespy codec plugin");
+        return -1;
+    }
+
+    self->library = library;
+    return 0;
+}
+
+void Plugin_dealloc(Plugin* self) {
+    if (self->library)
+        free_library(self->library);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+PyObject* Plugin_get_name(Plugin* self, void*) {
+    return PyUnicode_FromString(self->info().codec_name);
+}
+
+PyObject* Plugin_get_api_version(Plugin* self, void*) {
+    return PyLong_FromLong(self->info().api_version);
+}
+
+PyObject* Plugin_open(Plugin* self, PyObject* args, PyObject* kwargs);
+
+PyMethodDef Plugin_methods[] = {
+    {"open", (PyCFunction)(void (*)(void))Plugin_open, METH_VARARGS | METH_KEYWORDS,
+     "open(transport, codec_type, codec_specific_data, threads=0) -> Decoder\n\n"
+     "'threads' limits how many threads the plugin may use at once within one decode call, 0 for\n"
+     "one per core. Plugins that decode serially ignore it."},
+    {nullptr}};
+
+PyGetSetDef Plugin_getset[] = {
+    {"name", (getter)Plugin_get_name, nullptr, "Codec name from bluespy_codec_info", nullptr},
+    {"api_version", (getter)Plugin_get_api_version, nullptr, "Plugin API version", nullptr},
+    {nullptr}};
+
+PyTypeObject PluginType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+// Decoder
+
+void Decoder_dealloc(Decoder* self) {
+    if (self->handle)
+        self->plugin->deinit(self->handle);
+    Py_XDECREF(self->plugin);
+    Py_TYPE(self)->tp_free((PyObject*)self);
+}
+
+// Holds a contiguous view of each packet for the duration of a batch
+struct packet_views {
+    std::vector<Py_buffer> views;
+    ~packet_views() {
+        for (auto& v : views)
+            PyBuffer_Release(&v);
+    }
+};
+
+PyObject* Decoder_decode_batch(Decoder* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"packets", "out", "offsets", nullptr};
+    PyObject *packets_obj, *out_obj, *offsets_obj = Py_None;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O", const_cast<char**>(keywords),
+                                     &packets_obj, &out_obj, &offsets_obj))
+        return nullptr;
+
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Decoder is in use by another thread");
+        return nullptr;
+    }
+
+    Py_buffer out;
+    if (PyObject_GetBuffer(out_obj, &out, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT))
+        return nullptr;
+
+    if (!is_signed_int(out, 2)) {
+        PyBuffer_Release(&out);
+        PyErr_SetString(PyExc_TypeError, "out must be a contiguous int16 buffer");
+        return nullptr;
+    }
+
+    // Either a sequence of packets, or one buffer split at 'offsets' (n + 1 int64 entries)
+    packet_views packets;
+    std::vector<const uint8_t*> data;
+    std::vector<int> lengths;
+
+    if (offsets_obj == Py_None) {
+        PyObject* seq = PySequence_Fast(packets_obj, "packets must be a sequence of buffers");
+        if (!seq) {
+            PyBuffer_Release(&out);
+            return nullptr;
+        }
+
+        Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+        packets.views.reserve(n);
+
+        for (Py_ssize_t i = 0; i < n; ++i) {
+            Py_buffer view;
+            if (PyObject_GetBuffer(PySequence_Fast_GET_ITEM(seq, i), &view, PyBUF_C_CONTIGUOUS)) {
+                Py_DECREF(seq);
+                PyBuffer_Release(&out);
+                return nullptr;
+            }
+            packets.views.push_back(view);
+            data.push_back((const uint8_t*)view.buf);
+            lengths.push_back((int)view.len);
+        }
+
+        Py_DECREF(seq);
+    } else {
+        Py_buffer view, offsets;
+        if (PyObject_GetBuffer(packets_obj, &view, PyBUF_C_CONTIGUOUS)) {
+            PyBuffer_Release(&out);
+            return nullptr;
+        }
+        packets.views.push_back(view);
+
+        if (PyObject_GetBuffer(offsets_obj, &offsets, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT)) {
+            PyBuffer_Release(&out);
+            return nullptr;
+        }
+        packets.views.push_back(offsets);
+
+        if (!is_signed_int(offsets, 8)) {
+            PyBuffer_Release(&out);
+            PyErr_SetString(PyExc_TypeError, "offsets must be a contiguous int64 buffer");
+            return nullptr;
+        }
+
+        const int64_t* o = (const int64_t*)offsets.buf;
+        Py_ssize_t n = offsets.len / 8;
+
+        for (Py_ssize_t i = 0; i + 1 < n; ++i) {
+            if (o[i] < 0 || o[i + 1] < o[i] || o[i + 1] > view.len) {
+                PyBuffer_Release(&out);
+                PyErr_SetString(PyExc_ValueError, "offsets out of range");
+                return nullptr;
+            }
+            data.push_back((const uint8_t*)view.buf + o[i]);
+            lengths.push_back((int)(o[i + 1] - o[i]));
+        }
+    }
+
+    // Each entry is the sample count or negative BLUESPY_CODEC_ERRORS for that packet. Decoding
+    // stops early if the output runs out, so fewer counts than packets are returned.
+    std::vector<int> counts;
+    counts.reserve(data.size());
+
+    int16_t* uncoded = (int16_t*)out.buf;
+    Py_ssize_t remaining = out.len / 2;
+
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+
+    for (size_t i = 0; i < data.size(); ++i) {
+        int len = remaining > INT32_MAX ? INT32_MAX : (int)remaining;
+        int r = self->plugin->decode(self->handle, data[i], lengths[i], uncoded, len);
+
+        if (r == BLUESPY_CODEC_BUFFER_TOO_SMALL)
+            break;
+
+        counts.push_back(r);
+
+        if (r == BLUESPY_CODEC_UNRECOVERABLE_ERROR)
+            break;
+
+        if (r > 0) {
+            uncoded += r;
+            remaining -= r;
+        }
+    }
+
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    PyBuffer_Release(&out);
+
+    PyObject* result = PyList_New(counts.size());
+    if (!result)
+        return nullptr;
+
+    for (size_t i = 0; i < counts.size(); ++i)
+        PyList_SET_ITEM(result, i, PyLong_FromLong(counts[i]));
+
+    return result;
+}
+
+PyObject* Decoder_flush(Decoder* self, PyObject* args) {
+    PyObject* out_obj;
+    if (!PyArg_ParseTuple(args, "O", &out_obj))
+        return nullptr;
+
+    if (self->busy) {
+        PyErr_SetString(PyExc_RuntimeError, "Decoder is in use by another thread");
+        return nullptr;
+    }
+
+    Py_buffer out;
+    if (PyObject_GetBuffer(out_obj, &out, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT))
+        return nullptr;
+
+    if (!is_signed_int(out, 2)) {
+        PyBuffer_Release(&out);
+        PyErr_SetString(PyExc_TypeError, "out must be a contiguous int16 buffer");
+        return nullptr;
+    }
+
+    int16_t* uncoded = (int16_t*)out.buf;
+    int len = out.len / 2 > INT32_MAX ? INT32_MAX : (int)(out.len / 2);
+    int r;
+
+    self->busy = true;
+    Py_BEGIN_ALLOW_THREADS
+    r = self->plugin->decode(self->handle, nullptr, 0, uncoded, len);
+    Py_END_ALLOW_THREADS
+    self->busy = false;
+
+    PyBuffer_Release(&out);
+
+    return PyLong_FromLong(r);
+}
+
+PyMethodDef Decoder_methods[] = {
+    {"decode_batch", (PyCFunction)(void (*)(void))Decoder_decode_batch,
+     METH_VARARGS | METH_KEYWORDS,
+     "decode_batch(packets, out, offsets=None) -> list of sample counts\n\n"
+     "Decodes each packet into the int16 buffer 'out', one after another. 'packets' is either a\n"
+     "sequence of bytes-like objects, or a single buffer split by the int64 array 'offsets'."},
+    {"flush", (PyCFunction)Decoder_flush, METH_VARARGS,
+     "flush(out) -> sample count\n\nEnds the stream, writing any delayed samples into 'out'."},
+    {nullptr}};
+
+PyObject* Decoder_get(Decoder* self, void* closure) {
+    switch ((intptr_t)closure) {
+    case 0:
+        return PyUnicode_FromString(self->config.codec_name ? self->config.codec_name : "");
+    case 1:
+        return PyLong_FromUnsignedLong(self->config.sample_rate);
+    case 2:
+        return PyLong_FromUnsignedLong(self->config.channels);
+    case 3:
+        return PyLong_FromUnsignedLong(self->config.seek_pre_frames);
+    case 4:
+        return PyLong_FromUnsignedLong(self->config.min_output_size);
+    default:
+        return PyLong_FromUnsignedLong(self->config.min_bitrate);
+    }
+}
+
+PyGetSetDef Decoder_getset[] = {
+    {"codec_name", (getter)Decoder_get, nullptr, nullptr, (void*)0},
+    {"sample_rate", (getter)Decoder_get, nullptr, nullptr, (void*)1},
+    {"channels", (getter)Decoder_get, nullptr, nullptr, (void*)2},
+    {"seek_pre_frames", (getter)Decoder_get, nullptr, nullptr, (void*)3},
+    {"min_output_size", (getter)Decoder_get, nullptr, nullptr, (void*)4},
+    {"min_bitrate", (getter)Decoder_get, nullptr, nullptr, (void*)5},
+    {nullptr}};
+
+PyTypeObject DecoderType = {PyVarObject_HEAD_INIT(nullptr, 0)};
+
+PyObject* Plugin_open(Plugin* self, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"transport", "codec_type", "codec_specific_data", "threads",
+                                     nullptr};
+    int transport, codec_type;
+    unsigned threads = 0;
+    Py_buffer config;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iiy*|I", const_cast<char**>(keywords),
+                                     &transport, &codec_type, &config, &threads))
+        return nullptr;
+
+    if (!threads)
+        threads = std::thread::hardware_concurrency();
+
+    bluespy_codec_executor executor{nullptr, threads, executor_submit, executor_wait};
+
+    auto r = self->init_ex ? self->init_ex((BLUESPY_CODEC_TRANSPORT)transport, codec_type,
+                                           config.buf, (int)config.len,
+                                           threads > 1 ? &executor : nullptr)
+                           : self->init((BLUESPY_CODEC_TRANSPORT)transport, codec_type,
+                                        config.buf, (int)config.len);
+    PyBuffer_Release(&config);
+
+    if (r.result != BLUESPY_CODEC_SUCCESS) {
+        PyErr_Format(PyExc_ValueError, "Codec init failed (%d)", (int)r.result);
+        return nullptr;
+    }
+
+    Decoder* decoder = PyObject_New(Decoder, &DecoderType);
+    if (!decoder) {
+        self->deinit(r.handle);
+        return nullptr;
+    }
+
+    Py_INCREF(self);
+    decoder->plugin = self;
+    decoder->handle = r.handle;
+    decoder->config = r;
+    decoder->busy = false;
+
+    return (PyObject*)decoder;
+}
+
+PyModuleDef module = {PyModuleDef_HEAD_INIT, "bluespy_codecs",
+                      "Batch decoding through blueSPY codec plugins", -1};
+
+} // namespace
+
+PyMODINIT_FUNC PyInit_bluespy_codecs() {
+    PluginType.tp_name = "bluespy_codecs.Plugin";
+    PluginType.tp_doc = "Plugin(path)\n\nA codec plugin shared library";
+    PluginType.tp_basicsize = sizeof(Plugin);
+    PluginType.tp_flags = Py_TPFLAGS_DEFAULT;
+    PluginType.tp_new = PyType_GenericNew;
+    PluginType.tp_init = (initproc)Plugin_init;
+    PluginType.tp_dealloc = (destructor)Plugin_dealloc;
+    PluginType.tp_methods = Plugin_methods;
+    PluginType.tp_getset = Plugin_getset;
+
+    DecoderType.tp_name = "bluespy_codecs.Decoder";
+    DecoderType.tp_doc = "A decoder handle, created by Plugin.open";
+    DecoderType.tp_basicsize = sizeof(Decoder);
+    DecoderType.tp_flags = Py_TPFLAGS_DEFAULT;
+    DecoderType.tp_dealloc = (destructor)Decoder_dealloc;
+    DecoderType.tp_methods = Decoder_methods;
+    DecoderType.tp_getset = Decoder_getset;
+
+    if (PyType_Ready(&PluginType) < 0 || PyType_Ready(&DecoderType) < 0)
+        return nullptr;
+
+    PyObject* m = PyModule_Create(&module);
+    if (!m)
+        return nullptr;
+
+    Py_INCREF(&PluginType);
+    PyModule_AddObject(m, "Plugin", (PyObject*)&PluginType);
+    PyModule_AddIntConstant(m, "A2DP", BLUESPY_CODEC_A2DP);
+    PyModule_AddIntConstant(m, "A2DP_MPEG_24_AAC", BLUESPY_CODEC_A2DP_MPEG_24_AAC);
+    PyModule_AddIntConstant(m, "A2DP_Non_A2DP", BLUESPY_CODEC_A2DP_Non_A2DP);
+
+    return m;
+}
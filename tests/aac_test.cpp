@@ -0,0 +1,160 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Packet handling of the aac plugin, decoding through stub_fdk_aac.cpp
+
+#include "bluespy_codec_interface.h"
+
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);               \
+            ++failures;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+// An RTP packet with one payload byte per frame, each frame decoding to its byte's value
+static std::vector<uint8_t> packet(uint16_t seq, std::vector<uint8_t> frames) {
+    std::vector<uint8_t> p{0x80, 0x60, uint8_t(seq >> 8), uint8_t(seq), 0, 0, 0, 0, 0, 0, 0, 0};
+    p.insert(p.end(), frames.begin(), frames.end());
+    return p;
+}
+
+static bluespy_codec_handle* open_stereo() {
+    const uint8_t config[6] = {0x80, 0x01, 0x04, 0x83, 0xE8, 0x00}; // MPEG-2 AAC-LC 44.1 kHz
+    auto r = bluespy_codec_init(BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_MPEG_24_AAC, config, 6);
+    CHECK(r.result == BLUESPY_CODEC_SUCCESS);
+    CHECK(r.channels == 2);
+    return r.handle;
+}
+
+static int decode(bluespy_codec_handle* handle, const std::vector<uint8_t>& p,
+                  std::vector<int16_t>& out) {
+    return bluespy_codec_decode(handle, p.data(), (int)p.size(), out.data(), (int)out.size());
+}
+
+// Whether out holds each frame's value in turn, for 1024 stereo samples per frame
+static bool holds(const std::vector<int16_t>& out, std::vector<int16_t> frames) {
+    for (size_t i = 0; i < frames.size() * 2048; ++i)
+        if (out[i] != frames[i / 2048])
+            return false;
+    return true;
+}
+
+// Every frame of a packet is decoded, across several aacDecoder_Fill calls
+static void test_multi_frame() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(16 * 2048);
+
+    CHECK(decode(handle, packet(1, {1, 2, 3, 4, 5, 6}), out) == 6 * 2048);
+    CHECK(holds(out, {1, 2, 3, 4, 5, 6}));
+    CHECK(decode(handle, packet(2, {7}), out) == 2048);
+    CHECK(holds(out, {7}));
+
+    bluespy_codec_deinit(handle);
+}
+
+// A buffer that exactly fits the packet's frames is enough, and one too small for even the first
+// frame is refused without consuming the packet
+static void test_exact_fit() {
+    auto handle = open_stereo();
+    std::vector<int16_t> one(2048), three(3 * 2048), short_one(2047);
+
+    CHECK(decode(handle, packet(1, {1}), one) == 2048);
+    CHECK(holds(one, {1}));
+    CHECK(decode(handle, packet(2, {2, 3, 4}), three) == 3 * 2048);
+    CHECK(holds(three, {2, 3, 4}));
+
+    CHECK(decode(handle, packet(3, {5}), short_one) == BLUESPY_CODEC_BUFFER_TOO_SMALL);
+    CHECK(decode(handle, packet(3, {5}), one) == 2048);
+    CHECK(holds(one, {5}));
+
+    // More frames than the buffer was sized for, found after the input is consumed
+    CHECK(decode(handle, packet(4, {6, 7}), one) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+
+    bluespy_codec_error_detail errors[4];
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 1);
+    CHECK(errors[0].sequence_number == 4);
+
+    bluespy_codec_deinit(handle);
+}
+
+// End of stream gives the delayed frame once, then nothing until more is decoded
+static void test_flush() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(2048), short_out(2047);
+
+    CHECK(bluespy_codec_decode(handle, nullptr, 0, out.data(), (int)out.size()) == 0);
+    CHECK(decode(handle, packet(1, {1}), out) == 2048);
+    CHECK(bluespy_codec_decode(handle, nullptr, 0, short_out.data(), (int)short_out.size()) ==
+          BLUESPY_CODEC_BUFFER_TOO_SMALL);
+    CHECK(bluespy_codec_decode(handle, nullptr, 0, out.data(), (int)out.size()) == 2048);
+    CHECK(holds(out, {-1}));
+    CHECK(bluespy_codec_decode(handle, nullptr, 0, out.data(), (int)out.size()) == 0);
+
+    bluespy_codec_deinit(handle);
+}
+
+// A failed flush is logged against the last packet, and still ends the stream
+static void test_flush_error() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(2048);
+    bluespy_codec_error_detail errors[4];
+
+    CHECK(decode(handle, packet(7, {0xFE}), out) == 2048);
+    CHECK(bluespy_codec_decode(handle, nullptr, 0, out.data(), (int)out.size()) ==
+          BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 1);
+    CHECK(errors[0].sequence_number == 7);
+    CHECK(errors[0].result == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(bluespy_codec_decode(handle, nullptr, 0, out.data(), (int)out.size()) == 0);
+
+    bluespy_codec_deinit(handle);
+}
+
+// Errors are logged at the offset of the frame that failed, not of the data filled with it
+static void test_error_offset() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(16 * 2048);
+    bluespy_codec_error_detail errors[4];
+
+    // The stub buffers 4 bytes at a time, so frame 5 is the second frame of the second fill
+    CHECK(decode(handle, packet(1, {1, 2, 0}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(decode(handle, packet(2, {1, 2, 3, 4, 5, 0}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 2);
+    CHECK(errors[0].sequence_number == 1 && errors[0].byte_offset == 12 + 2);
+    CHECK(errors[1].sequence_number == 2 && errors[1].byte_offset == 12 + 5);
+
+    bluespy_codec_deinit(handle);
+}
+
+// A packet that stalls fdk-aac is given up on rather than filled forever
+static void test_stalled_fill() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(16 * 2048);
+    bluespy_codec_error_detail errors[4];
+
+    CHECK(decode(handle, packet(1, {0xFF, 1, 2, 3, 4, 5}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 1);
+    CHECK(errors[0].sequence_number == 1 && errors[0].byte_offset == 12);
+
+    bluespy_codec_deinit(handle);
+}
+
+int main() {
+    test_multi_frame();
+    test_exact_fit();
+    test_flush();
+    test_flush_error();
+    test_error_offset();
+    test_stalled_fill();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,188 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// RTP header detection and error logging of the aptx plugin, decoding through stub_freeaptx.cpp
+
+#include "bluespy_codec_interface.h"
+
+#include <cstdio>
+#include <vector>
+
+extern "C" int stub_aptx_resets;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);               \
+            ++failures;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+// An RTP packet with payload type 96, with the timestamp advancing 4 samples per codeword
+static std::vector<uint8_t> rtp_packet(uint16_t seq, std::vector<uint8_t> codewords) {
+    uint32_t ts = seq * 4 * (uint32_t)codewords.size();
+    std::vector<uint8_t> p{0x80, 0x60, uint8_t(seq >> 8), uint8_t(seq)};
+    for (int shift = 24; shift >= 0; shift -= 8)
+        p.push_back(uint8_t(ts >> shift));
+    p.insert(p.end(), 4, 0); // SSRC
+    for (uint8_t c : codewords)
+        p.insert(p.end(), {c, c, c, c});
+    return p;
+}
+
+// A packet of bare codewords
+static std::vector<uint8_t> raw_packet(std::vector<uint8_t> codewords) {
+    std::vector<uint8_t> p;
+    for (uint8_t c : codewords)
+        p.insert(p.end(), {c, c, c, c});
+    return p;
+}
+
+// A packet of bare codewords that starts with the given bytes, as if it had an RTP header
+static std::vector<uint8_t> lookalike_packet(uint8_t b0, uint8_t b1) {
+    std::vector<uint8_t> p{b0, b1, 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC};
+    auto rest = raw_packet({1, 2});
+    p.insert(p.end(), rest.begin(), rest.end());
+    return p;
+}
+
+static bluespy_codec_handle* open_aptx() {
+    const uint8_t config[7] = {0x4F, 0, 0, 0, 0x01, 0x00, 0x12}; // aptX, 48 kHz stereo
+    auto r = bluespy_codec_init(BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_Non_A2DP, config, 7);
+    CHECK(r.result == BLUESPY_CODEC_SUCCESS);
+    return r.handle;
+}
+
+static int decode(bluespy_codec_handle* handle, const std::vector<uint8_t>& p,
+                  std::vector<int16_t>& out) {
+    return bluespy_codec_decode(handle, p.data(), (int)p.size(), out.data(), (int)out.size());
+}
+
+// Whether out starts with 8 samples of each codeword's value in turn
+static bool holds(const std::vector<int16_t>& out, std::vector<uint8_t> codewords) {
+    for (size_t i = 0; i < codewords.size() * 8; ++i)
+        if (out[i] != codewords[i / 8])
+            return false;
+    return true;
+}
+
+// Consecutive RTP packets confirm the header, which is then skipped without further checks
+static void test_rtp_present() {
+    auto handle = open_aptx();
+    std::vector<int16_t> out(256);
+    int resets = stub_aptx_resets;
+
+    CHECK(decode(handle, rtp_packet(10, {1, 2, 3}), out) == 24);
+    CHECK(holds(out, {1, 2, 3}));
+    CHECK(decode(handle, rtp_packet(11, {4, 5, 6}), out) == 24);
+    CHECK(holds(out, {4, 5, 6}));
+
+    // Latched, so a later packet that would fail the checks is still taken as RTP
+    auto odd = rtp_packet(40, {7});
+    odd[1] = 0x10;
+    CHECK(decode(handle, odd, out) == 8);
+    CHECK(holds(out, {7}));
+    CHECK(stub_aptx_resets == resets);
+
+    bluespy_codec_deinit(handle);
+}
+
+// Bare codewords are decoded whole from the first packet
+static void test_rtp_absent() {
+    auto handle = open_aptx();
+    std::vector<int16_t> out(256);
+    int resets = stub_aptx_resets;
+
+    CHECK(decode(handle, raw_packet({1, 2, 3}), out) == 24);
+    CHECK(holds(out, {1, 2, 3}));
+    CHECK(decode(handle, raw_packet({0x80, 0x60, 4}), out) == 24);
+    CHECK(holds(out, {0x80, 0x60, 4}));
+    CHECK(stub_aptx_resets == resets);
+
+    bluespy_codec_deinit(handle);
+}
+
+// A first packet of audio that looks like an RTP header is decoded as RTP, then the next packet
+// shows it was not, so the decoder is reset and everything after is taken as bare codewords
+static void test_false_positive() {
+    auto handle = open_aptx();
+    std::vector<int16_t> out(256);
+    int resets = stub_aptx_resets;
+
+    CHECK(decode(handle, lookalike_packet(0x80, 0x60), out) == 8);
+    CHECK(holds(out, {2}));
+    CHECK(decode(handle, raw_packet({3, 4, 5}), out) == 24);
+    CHECK(holds(out, {3, 4, 5}));
+    CHECK(stub_aptx_resets == resets + 1);
+    CHECK(decode(handle, raw_packet({0x80, 0x60, 5}), out) == 24);
+
+    bluespy_codec_deinit(handle);
+}
+
+// Headers a stream of audio is unlikely to carry, as aptX over RTP does not use them, are not
+// taken as RTP even on the first packet
+static void test_unlikely_headers() {
+    std::vector<int16_t> out(256);
+
+    const uint8_t headers[][2] = {
+        {0x90, 0x60}, // Extension
+        {0x81, 0x60}, // CSRC
+        {0x80, 0x5F}, // Static payload type
+        {0x40, 0x60}, // Version 1
+    };
+
+    for (auto h : headers) {
+        auto handle = open_aptx();
+        CHECK(decode(handle, lookalike_packet(h[0], h[1]), out) == 32);
+        CHECK(holds(out, {h[0], 0x56, 1, 2}));
+        bluespy_codec_deinit(handle);
+    }
+}
+
+// A probe packet refused for a small buffer and retried is not taken as the confirming packet
+static void test_probe_retry() {
+    auto handle = open_aptx();
+    std::vector<int16_t> small(16), out(256);
+    int resets = stub_aptx_resets;
+
+    auto first = rtp_packet(1, {1, 2, 3});
+    CHECK(decode(handle, first, small) == BLUESPY_CODEC_BUFFER_TOO_SMALL);
+    CHECK(decode(handle, first, out) == 24);
+    CHECK(holds(out, {1, 2, 3}));
+    CHECK(decode(handle, rtp_packet(2, {4, 5, 6}), out) == 24);
+    CHECK(holds(out, {4, 5, 6}));
+    CHECK(stub_aptx_resets == resets);
+
+    bluespy_codec_deinit(handle);
+}
+
+// Codewords after a loss of sync are skipped, and logged with a result of success as the packet
+// still gives the samples before them
+static void test_sync_error() {
+    auto handle = open_aptx();
+    std::vector<int16_t> out(256);
+    bluespy_codec_error_detail errors[4];
+
+    CHECK(decode(handle, raw_packet({1, 0, 2}), out) == 8);
+    CHECK(holds(out, {1}));
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 1);
+    CHECK(errors[0].result == BLUESPY_CODEC_SUCCESS);
+    CHECK(errors[0].sequence_number == -1 && errors[0].byte_offset == 4);
+
+    bluespy_codec_deinit(handle);
+}
+
+int main() {
+    test_rtp_present();
+    test_rtp_absent();
+    test_false_positive();
+    test_unlikely_headers();
+    test_probe_retry();
+    test_sync_error();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
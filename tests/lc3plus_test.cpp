@@ -0,0 +1,163 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Packet handling of the lc3plus plugin, decoding through stub_lc3plus.cpp
+
+#include "bluespy_codec_interface.h"
+
+#include <cstdio>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);               \
+            ++failures;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+const int FRAME_SAMPLES = 480; // 10 ms at 48 kHz
+
+// An RTP packet with the given LC3plus payload header and payload
+static std::vector<uint8_t> packet(uint16_t seq, uint8_t header, std::vector<uint8_t> payload) {
+    std::vector<uint8_t> p{0x80, 0x60, uint8_t(seq >> 8), uint8_t(seq), 0, 0, 0, 0, 0, 0, 0, 0,
+                           header};
+    p.insert(p.end(), payload.begin(), payload.end());
+    return p;
+}
+
+static bluespy_codec_handle* open_stereo() {
+    // LC3plus HR, 10 ms frames, stereo, 48 kHz
+    const uint8_t config[10] = {0xA9, 0x08, 0, 0, 0x01, 0x00, 0x40, 0x40, 0x01, 0x00};
+    auto r = bluespy_codec_init(BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_Non_A2DP, config, 10);
+    CHECK(r.result == BLUESPY_CODEC_SUCCESS);
+    CHECK(r.sample_rate == 48000 && r.channels == 2);
+    CHECK(r.min_output_size == 15 * FRAME_SAMPLES * 2);
+    return r.handle;
+}
+
+static int decode(bluespy_codec_handle* handle, const std::vector<uint8_t>& p,
+                  std::vector<int16_t>& out) {
+    return bluespy_codec_decode(handle, p.data(), (int)p.size(), out.data(), (int)out.size());
+}
+
+// Whether frame f of out decoded from a frame of len bytes summing to sum
+static bool holds(const std::vector<int16_t>& out, int f, int16_t len, int16_t sum) {
+    for (int i = f * FRAME_SAMPLES; i < (f + 1) * FRAME_SAMPLES; ++i)
+        if (out[2 * i] != len || out[2 * i + 1] != sum)
+            return false;
+    return true;
+}
+
+// The payload header's frame count splits the payload into equal frames
+static void test_frame_count() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(15 * FRAME_SAMPLES * 2), one(FRAME_SAMPLES * 2);
+
+    CHECK(decode(handle, packet(1, 0x03, {1, 2, 3, 4, 5, 6}), out) == 3 * FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 2, 3) && holds(out, 1, 2, 7) && holds(out, 2, 2, 11));
+
+    CHECK(decode(handle, packet(2, 0x01, {7, 8, 9}), one) == FRAME_SAMPLES * 2);
+    CHECK(holds(one, 0, 3, 24));
+
+    // A CSRC moves the payload header along
+    auto csrc = packet(3, 0x00, {0, 0, 0, 0x01, 5});
+    csrc[0] = 0x81;
+    CHECK(decode(handle, csrc, one) == FRAME_SAMPLES * 2);
+    CHECK(holds(one, 0, 1, 5));
+
+    CHECK(decode(handle, packet(4, 0x02, {1, 2}), one) == BLUESPY_CODEC_BUFFER_TOO_SMALL);
+
+    bluespy_codec_deinit(handle);
+}
+
+// Payload headers that do not describe the payload are logged at the payload header
+static void test_bad_frame_count() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(15 * FRAME_SAMPLES * 2);
+    bluespy_codec_error_detail errors[4];
+
+    CHECK(decode(handle, packet(1, 0x00, {1, 2}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(decode(handle, packet(2, 0x02, {1, 2, 3}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 2);
+    CHECK(errors[0].sequence_number == 1 && errors[0].byte_offset == 12);
+    CHECK(errors[1].sequence_number == 2 && errors[1].byte_offset == 12);
+
+    bluespy_codec_deinit(handle);
+}
+
+// A frame split over consecutive packets is decoded when its last fragment arrives
+static void test_fragments() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(FRAME_SAMPLES * 2);
+
+    CHECK(decode(handle, packet(1, 0xC0, {1, 2, 3}), out) == 0);
+    CHECK(decode(handle, packet(2, 0x80, {4, 5}), out) == 0);
+    CHECK(decode(handle, packet(3, 0xA0, {6}), out) == FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 6, 21));
+
+    // The first fragment may also be the last
+    CHECK(decode(handle, packet(4, 0xE0, {7, 8}), out) == FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 2, 15));
+
+    // A new first fragment drops one that was never finished
+    CHECK(decode(handle, packet(5, 0xC0, {1, 1, 1}), out) == 0);
+    CHECK(decode(handle, packet(6, 0xC0, {9}), out) == 0);
+    CHECK(decode(handle, packet(7, 0xA0, {10}), out) == FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 2, 19));
+
+    bluespy_codec_deinit(handle);
+}
+
+// Fragments after a lost packet are dropped until the next frame starts
+static void test_lost_fragment() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(FRAME_SAMPLES * 2);
+    bluespy_codec_error_detail errors[4];
+
+    CHECK(decode(handle, packet(1, 0xC0, {1, 2}), out) == 0);
+    CHECK(decode(handle, packet(3, 0x80, {3}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(decode(handle, packet(4, 0xA0, {4}), out) == BLUESPY_CODEC_RECOVERABLE_ERROR);
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 2);
+    CHECK(errors[0].sequence_number == 3 && errors[1].sequence_number == 4);
+
+    CHECK(decode(handle, packet(5, 0xC0, {5}), out) == 0);
+    CHECK(decode(handle, packet(6, 0xA0, {6}), out) == FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 2, 11));
+
+    // Sequence numbers wrap
+    CHECK(decode(handle, packet(0xFFFF, 0xC0, {1}), out) == 0);
+    CHECK(decode(handle, packet(0, 0xA0, {2}), out) == FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 2, 3));
+
+    bluespy_codec_deinit(handle);
+}
+
+// A frame the library conceals still gives output, and is logged with a result of success
+static void test_concealed_frame() {
+    auto handle = open_stereo();
+    std::vector<int16_t> out(15 * FRAME_SAMPLES * 2);
+    bluespy_codec_error_detail errors[4];
+
+    CHECK(decode(handle, packet(1, 0x02, {1, 0}), out) == 2 * FRAME_SAMPLES * 2);
+    CHECK(holds(out, 0, 1, 1) && holds(out, 1, -1, -1));
+    CHECK(bluespy_codec_drain_errors(handle, errors, 4) == 1);
+    CHECK(errors[0].result == BLUESPY_CODEC_SUCCESS);
+    CHECK(errors[0].sequence_number == 1 && errors[0].byte_offset == 12 + 1 + 1);
+
+    bluespy_codec_deinit(handle);
+}
+
+int main() {
+    test_frame_count();
+    test_bad_frame_count();
+    test_fragments();
+    test_lost_fragment();
+    test_concealed_frame();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
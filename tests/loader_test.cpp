@@ -0,0 +1,163 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Manifest parsing and plugin loading of bluespy_codec_loader.hpp, against the libraries built from
+// loader_test_plugin.cpp. Takes the paths of their build-time manifests.
+
+#include "bluespy_codec_loader.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                                \
+    do {                                                                                           \
+        if (!(cond)) {                                                                             \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);               \
+            ++failures;                                                                            \
+        }                                                                                          \
+    } while (0)
+
+using namespace bluespy_codec_loader;
+
+static std::string directory(const std::string& path) {
+    auto slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+static std::string write_file(const std::string& path, const std::string& content) {
+    std::ofstream(path, std::ios::binary) << content;
+    return path;
+}
+
+static bluespy_codec_init_return init_sbc(registry& r, plugin** selected) {
+    return r.init(BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_SBC, nullptr, 0, selected);
+}
+
+// The manifest written at build time resolves the library next to it and matches its hash
+static void test_build_manifest(const std::string& path) {
+    manifest m;
+    CHECK(read_manifest(path, m));
+    CHECK(m.abi_version == 1);
+    CHECK(m.codec_name == "Loader test");
+    CHECK(m.library.compare(0, directory(path).size(), directory(path)) == 0);
+    CHECK(m.sha256.size() == 64 && m.sha256 == file_sha256(m.library));
+    CHECK(m.codecs.size() == 1);
+    CHECK(m.codecs[0].transport == 1 && m.codecs[0].media_codec_type == 0);
+    CHECK(!m.codecs[0].vendor_specific);
+}
+
+static void test_parse(const std::string& dir) {
+    manifest m;
+    auto path = write_file(dir + "loader_test_parse.manifest", "# Comment\r\n"
+                                                               "abi_version=1\r\n"
+                                                               "codec_name=Parse\r\n"
+                                                               "library=parse.so\r\n"
+                                                               "sha256=ABCDEF\r\n"
+                                                               "unknown=ignored\r\n"
+                                                               "codec=1:2\r\n"
+                                                               "codec=1:255:000008A9:0001\r\n");
+    CHECK(read_manifest(path, m));
+    CHECK(m.codec_name == "Parse");
+    CHECK(m.library == dir + "parse.so");
+    CHECK(m.sha256 == "abcdef");
+    CHECK(m.codecs.size() == 2);
+    CHECK(m.codecs[1].vendor_specific && m.codecs[1].vendor == 0x8A9 && m.codecs[1].codec_id == 1);
+
+    const uint8_t lc3plus_hr[6] = {0xA9, 0x08, 0, 0, 0x01, 0x00};
+    const uint8_t other[6] = {0xA9, 0x08, 0, 0, 0x02, 0x00};
+    CHECK(handles(m, BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_MPEG_24_AAC, nullptr, 0));
+    CHECK(handles(m, BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_Non_A2DP, lc3plus_hr, 6));
+    CHECK(!handles(m, BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_Non_A2DP, other, 6));
+    CHECK(!handles(m, BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_Non_A2DP, lc3plus_hr, 5));
+    CHECK(!handles(m, BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_SBC, nullptr, 0));
+
+    write_file(path, "abi_version=1\nlibrary=parse.so\ncodec=1\n");
+    CHECK(!read_manifest(path, m));
+    write_file(path, "abi_version=1\ncodec=1:2\n");
+    CHECK(!read_manifest(path, m));
+    CHECK(!read_manifest(dir + "loader_test_missing.manifest", m));
+}
+
+static void test_sha256(const std::string& dir) {
+    CHECK(file_sha256(write_file(dir + "loader_test_abc.txt", "abc")) ==
+          "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+    CHECK(file_sha256(write_file(dir + "loader_test_empty.txt", "")) ==
+          "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+    CHECK(file_sha256(dir + "loader_test_missing.txt").empty());
+}
+
+// A library that no longer matches its manifest is never opened
+static void test_hash_mismatch(const std::string& path) {
+    manifest m;
+    CHECK(read_manifest(path, m));
+    m.sha256 = std::string(64, '0');
+
+    plugin p(m);
+    CHECK(!p.verify());
+    CHECK(!p.load());
+    CHECK(!p.loaded());
+    CHECK(!p.init && !p.decode);
+}
+
+// A library without the whole interface is closed again, and stays unusable on later loads
+static void test_missing_symbols(const std::string& path) {
+    manifest m;
+    CHECK(read_manifest(path, m));
+
+    plugin p(m);
+    CHECK(p.verify());
+    CHECK(!p.load());
+    CHECK(!p.loaded());
+    CHECK(!p.init && !p.deinit && !p.decode);
+    CHECK(!p.load());
+
+    registry r;
+    CHECK(r.add_manifest(path));
+    plugin* selected = nullptr;
+    CHECK(init_sbc(r, &selected).result == BLUESPY_CODEC_UNSUPPORTED_CODEC);
+    CHECK(init_sbc(r, &selected).result == BLUESPY_CODEC_UNSUPPORTED_CODEC);
+    CHECK(!selected);
+}
+
+// The registry passes over plugins that cannot be loaded to the first that accepts the stream
+static void test_registry(const std::string& path, const std::string& partial_path) {
+    registry r;
+    CHECK(r.add_manifest(partial_path));
+    CHECK(r.add_manifest(path));
+    CHECK(r.all().size() == 2);
+
+    plugin* selected = nullptr;
+    CHECK(r.init(BLUESPY_CODEC_A2DP, BLUESPY_CODEC_A2DP_MPEG_24_AAC, nullptr, 0, &selected)
+              .result == BLUESPY_CODEC_UNSUPPORTED_CODEC);
+    CHECK(!r.all()[0]->loaded() && !r.all()[1]->loaded());
+
+    auto init = init_sbc(r, &selected);
+    CHECK(init.result == BLUESPY_CODEC_SUCCESS);
+    CHECK(selected == r.all()[1].get() && selected->loaded());
+    if (init.result != BLUESPY_CODEC_SUCCESS)
+        return;
+
+    int16_t out[2];
+    CHECK(selected->decode(init.handle, nullptr, 0, out, 2) == 0);
+    selected->deinit(init.handle);
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: loader_test <plugin manifest> <partial plugin manifest>\n");
+        return 2;
+    }
+
+    test_build_manifest(argv[1]);
+    test_parse(directory(argv[1]));
+    test_sha256(directory(argv[1]));
+    test_hash_mismatch(argv[1]);
+    test_missing_symbols(argv[2]);
+    test_registry(argv[1], argv[2]);
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,34 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// A plugin for loader_test that accepts any A2DP SBC stream and decodes nothing. Built a second
+// time with LOADER_TEST_NO_DECODE, as a library that does not export the whole plugin interface.
+
+#include "bluespy_codec_interface.h"
+
+struct bluespy_codec_handle {};
+
+bluespy_codec_info_return bluespy_codec_info() { return {1, "Loader test"}; }
+
+bluespy_codec_init_return bluespy_codec_init(BLUESPY_CODEC_TRANSPORT transport,
+                                             int media_codec_type, const void*, int) {
+    bluespy_codec_init_return r{BLUESPY_CODEC_UNSUPPORTED_CODEC};
+
+    if (transport != BLUESPY_CODEC_A2DP || media_codec_type != BLUESPY_CODEC_A2DP_SBC)
+        return r;
+
+    r.handle = new bluespy_codec_handle;
+    r.result = BLUESPY_CODEC_SUCCESS;
+    r.codec_name = "Loader test";
+    r.sample_rate = 48000;
+    r.channels = 2;
+    r.min_output_size = 2;
+
+    return r;
+}
+
+void bluespy_codec_deinit(bluespy_codec_handle* handle) { delete handle; }
+
+#ifndef LOADER_TEST_NO_DECODE
+int bluespy_codec_decode(bluespy_codec_handle*, const uint8_t*, int, int16_t*, int) { return 0; }
+#endif
@@ -0,0 +1,57 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Just enough of the fdk-aac decoder API for aac.cpp, see stub_fdk_aac.cpp
+
+#ifndef AACDECODER_LIB_H
+#define AACDECODER_LIB_H
+
+typedef int INT;
+typedef unsigned int UINT;
+typedef unsigned char UCHAR;
+typedef short INT_PCM;
+
+typedef enum {
+    AAC_DEC_OK = 0x0000,
+    AAC_DEC_OUT_OF_MEMORY = 0x0002,
+    AAC_DEC_UNKNOWN = 0x0005,
+    AAC_DEC_TRANSPORT_SYNC_ERROR = 0x1001,
+    AAC_DEC_NOT_ENOUGH_BITS = 0x1002,
+    AAC_DEC_INVALID_HANDLE = 0x2001,
+    AAC_DEC_OUTPUT_BUFFER_TOO_SMALL = 0x4005,
+} AAC_DECODER_ERROR;
+
+typedef enum { TT_MP4_LATM_MCP1 = 6 } TRANSPORT_TYPE;
+
+typedef enum { AOT_NONE = -1, AOT_AAC_LC = 2, AOT_SBR = 5 } AUDIO_OBJECT_TYPE;
+
+typedef enum {
+    AAC_PCM_MIN_OUTPUT_CHANNELS = 0x0011,
+    AAC_PCM_MAX_OUTPUT_CHANNELS = 0x0012,
+} AACDEC_PARAM;
+
+typedef struct {
+    INT sampleRate;
+    INT frameSize;
+    INT numChannels;
+    AUDIO_OBJECT_TYPE aot;
+} CStreamInfo;
+
+typedef struct AAC_DECODER_INSTANCE* HANDLE_AACDECODER;
+
+#define AACDEC_CONCEAL 1
+#define AACDEC_FLUSH 2
+#define AACDEC_INTR 4
+#define AACDEC_CLRHIST 8
+
+HANDLE_AACDECODER aacDecoder_Open(TRANSPORT_TYPE transportFmt, UINT nrOfLayers);
+void aacDecoder_Close(HANDLE_AACDECODER self);
+AAC_DECODER_ERROR aacDecoder_SetParam(HANDLE_AACDECODER self, AACDEC_PARAM param, INT value);
+AAC_DECODER_ERROR aacDecoder_Fill(HANDLE_AACDECODER self, UCHAR* pBuffer[],
+                                  const UINT bufferSize[], UINT* bytesValid);
+AAC_DECODER_ERROR aacDecoder_GetFreeBytes(HANDLE_AACDECODER self, UINT* pFreeBytes);
+AAC_DECODER_ERROR aacDecoder_DecodeFrame(HANDLE_AACDECODER self, INT_PCM* pTimeData,
+                                         INT timeDataSize, UINT flags);
+CStreamInfo* aacDecoder_GetStreamInfo(HANDLE_AACDECODER self);
+
+#endif // AACDECODER_LIB_H
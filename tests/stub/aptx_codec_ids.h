@@ -0,0 +1,15 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Stands in for the header bluespy_codec_manifest generates for the aptx plugin
+#ifndef APTX_CODEC_IDS_H
+#define APTX_CODEC_IDS_H
+#define APTX_VENDOR 0x0000004F
+#define APTX_CODEC_ID 0x0001
+#define APTX_HD_VENDOR 0x000000D7
+#define APTX_HD_CODEC_ID 0x0024
+#define APTX_LL_VENDOR 0x000000D7
+#define APTX_LL_CODEC_ID 0x0002
+#define APTX_LL_ALT_VENDOR 0x0000000A
+#define APTX_LL_ALT_CODEC_ID 0x0002
+#endif
@@ -0,0 +1,19 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Just enough of the libfreeaptx API for aptx.cpp, see stub_freeaptx.cpp
+
+#ifndef FREEAPTX_H
+#define FREEAPTX_H
+
+#include <stddef.h>
+
+struct aptx_context;
+
+struct aptx_context* aptx_init(int hd);
+void aptx_reset(struct aptx_context* ctx);
+void aptx_finish(struct aptx_context* ctx);
+size_t aptx_decode(struct aptx_context* ctx, const unsigned char* input, size_t input_size,
+                   unsigned char* output, size_t output_size, size_t* written);
+
+#endif
@@ -0,0 +1,31 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Just enough of the ETSI LC3plus API for lc3plus.cpp, see stub_lc3plus.cpp
+
+#ifndef LC3PLUS_H
+#define LC3PLUS_H
+
+#include <stdint.h>
+
+typedef enum {
+    LC3PLUS_OK = 0,
+    LC3PLUS_ERROR,
+    LC3PLUS_DECODE_ERROR,
+    LC3PLUS_NULL_ERROR,
+} LC3PLUS_Error;
+
+typedef enum { LC3PLUS_PLC_ADVANCED = 1 } LC3PLUS_PlcMode;
+
+typedef struct LC3PLUS_Dec LC3PLUS_Dec;
+
+int lc3plus_dec_get_size(int samplerate, int channels, LC3PLUS_PlcMode plc_mode);
+LC3PLUS_Error lc3plus_dec_init(LC3PLUS_Dec* decoder, int samplerate, int channels,
+                               LC3PLUS_PlcMode plc_mode, int hrmode);
+LC3PLUS_Error lc3plus_dec_set_frame_dms(LC3PLUS_Dec* decoder, int frame_dms);
+int lc3plus_dec_get_scratch_size(const LC3PLUS_Dec* decoder);
+int lc3plus_dec_get_output_samples(const LC3PLUS_Dec* decoder);
+LC3PLUS_Error lc3plus_dec16(LC3PLUS_Dec* decoder, void* input_bytes, int num_bytes,
+                            int16_t** output_samples, void* scratch, int bfi_ext);
+
+#endif
@@ -0,0 +1,9 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// Stands in for the header bluespy_codec_manifest generates for the lc3plus plugin
+#ifndef LC3PLUS_CODEC_IDS_H
+#define LC3PLUS_CODEC_IDS_H
+#define LC3PLUS_HR_VENDOR 0x000008A9
+#define LC3PLUS_HR_CODEC_ID 0x0001
+#endif
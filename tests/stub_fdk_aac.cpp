@@ -0,0 +1,86 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// A stand-in for fdk-aac, so the aac plugin's packet handling can be tested without the codec.
+// Each byte of payload is one frame, decoding to 1024 samples per channel of that byte's value, or
+// failing if it is 0. 0xFF starts a frame longer than the buffer, which never decodes. A flush
+// gives one frame of -1, the "delayed" samples of the last frame, and fails if that frame was 0xFE.
+
+extern "C" {
+#include "aacdecoder_lib.h"
+}
+#include <cstring>
+
+const UINT BUFFER_SIZE = 4; // Small, so a packet takes several aacDecoder_Fill calls
+
+struct AAC_DECODER_INSTANCE {
+    UCHAR buffer[BUFFER_SIZE];
+    UINT buffered = 0;
+    bool delayed = false; // Whether a flush has a frame to give
+    CStreamInfo info{};
+};
+
+extern "C" {
+
+HANDLE_AACDECODER aacDecoder_Open(TRANSPORT_TYPE, UINT) { return new AAC_DECODER_INSTANCE; }
+
+void aacDecoder_Close(HANDLE_AACDECODER self) { delete self; }
+
+AAC_DECODER_ERROR aacDecoder_SetParam(HANDLE_AACDECODER self, AACDEC_PARAM param, INT value) {
+    if (param == AAC_PCM_MAX_OUTPUT_CHANNELS)
+        self->info.numChannels = value;
+    return AAC_DEC_OK;
+}
+
+AAC_DECODER_ERROR aacDecoder_Fill(HANDLE_AACDECODER self, UCHAR* pBuffer[],
+                                  const UINT bufferSize[], UINT* bytesValid) {
+    UINT n = BUFFER_SIZE - self->buffered;
+    if (n > *bytesValid)
+        n = *bytesValid;
+
+    memcpy(self->buffer + self->buffered, pBuffer[0] + bufferSize[0] - *bytesValid, n);
+    self->buffered += n;
+    *bytesValid -= n;
+    return AAC_DEC_OK;
+}
+
+AAC_DECODER_ERROR aacDecoder_GetFreeBytes(HANDLE_AACDECODER self, UINT* pFreeBytes) {
+    *pFreeBytes = BUFFER_SIZE - self->buffered;
+    return AAC_DEC_OK;
+}
+
+AAC_DECODER_ERROR aacDecoder_DecodeFrame(HANDLE_AACDECODER self, INT_PCM* pTimeData,
+                                         INT timeDataSize, UINT flags) {
+    INT_PCM value;
+
+    if (flags & AACDEC_FLUSH) {
+        if (!self->delayed)
+            return AAC_DEC_UNKNOWN;
+        value = -1;
+        self->delayed = false;
+    } else if (self->buffered && self->buffer[0] == 0xFF) {
+        return AAC_DEC_NOT_ENOUGH_BITS;
+    } else if (self->buffered) {
+        value = self->buffer[0];
+        memmove(self->buffer, self->buffer + 1, --self->buffered);
+        self->delayed = value != 0xFE;
+    } else {
+        return AAC_DEC_NOT_ENOUGH_BITS;
+    }
+
+    if (value == 0)
+        return AAC_DEC_UNKNOWN;
+
+    self->info.frameSize = 1024;
+    self->info.aot = AOT_AAC_LC;
+
+    if (timeDataSize < self->info.frameSize * self->info.numChannels)
+        return AAC_DEC_OUTPUT_BUFFER_TOO_SMALL;
+
+    for (INT i = 0; i < self->info.frameSize * self->info.numChannels; ++i)
+        pTimeData[i] = value;
+    return AAC_DEC_OK;
+}
+
+CStreamInfo* aacDecoder_GetStreamInfo(HANDLE_AACDECODER self) { return &self->info; }
+}
@@ -0,0 +1,49 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// A stand-in for libfreeaptx, so the aptx plugin's packet handling can be tested without the codec.
+// Each codeword decodes to 4 stereo 24 bit samples whose top 16 bits are its first byte. Decoding
+// stops at a codeword starting with 0, as at a synchronisation error. Resets are counted in
+// stub_aptx_resets.
+
+extern "C" {
+#include "freeaptx.h"
+}
+#include <cstdint>
+
+extern "C" {
+
+int stub_aptx_resets = 0;
+
+struct aptx_context {
+    int hd;
+};
+
+struct aptx_context* aptx_init(int hd) { return new aptx_context{hd}; }
+
+void aptx_reset(struct aptx_context*) { ++stub_aptx_resets; }
+
+void aptx_finish(struct aptx_context* ctx) { delete ctx; }
+
+size_t aptx_decode(struct aptx_context* ctx, const unsigned char* input, size_t input_size,
+                   unsigned char* output, size_t output_size, size_t* written) {
+    size_t codeword = ctx->hd ? 6 : 4, processed = 0;
+    *written = 0;
+
+    for (; processed + codeword <= input_size && input[processed]; processed += codeword) {
+        for (int i = 0; i < 8 && *written + 3 <= output_size; ++i, *written += 3) {
+            output[*written] = 0; // Low byte of the 24 bit sample
+            output[*written + 1] = input[processed];
+            output[*written + 2] = 0;
+        }
+    }
+
+    return processed;
+}
+
+size_t aptx_decode_subbands(struct aptx_context* ctx, const unsigned char* input,
+                            size_t input_size, unsigned char* output, size_t output_size,
+                            size_t* written, float[2][8], int32_t[2][8]) {
+    return aptx_decode(ctx, input, input_size, output, output_size, written);
+}
+}
@@ -0,0 +1,56 @@
+// Copyright RF Creations Ltd 2023
+// Distributed under the Boost Software License, Version 1.0. (See accompanying file LICENSE)
+
+// A stand-in for the ETSI LC3plus decoder, so the lc3plus plugin's packet handling can be tested
+// without the codec. Each frame decodes to its length in the first channel and the sum of its
+// bytes in the second. A frame starting with 0 is concealed as a decode error, giving -1.
+
+extern "C" {
+#include "lc3plus.h"
+}
+
+struct LC3PLUS_Dec {
+    int samplerate;
+    int channels;
+    int frame_dms;
+};
+
+extern "C" {
+
+int lc3plus_dec_get_size(int, int, LC3PLUS_PlcMode) { return sizeof(LC3PLUS_Dec); }
+
+LC3PLUS_Error lc3plus_dec_init(LC3PLUS_Dec* decoder, int samplerate, int channels,
+                               LC3PLUS_PlcMode, int) {
+    decoder->samplerate = samplerate;
+    decoder->channels = channels;
+    decoder->frame_dms = 100;
+    return LC3PLUS_OK;
+}
+
+LC3PLUS_Error lc3plus_dec_set_frame_dms(LC3PLUS_Dec* decoder, int frame_dms) {
+    decoder->frame_dms = frame_dms;
+    return LC3PLUS_OK;
+}
+
+int lc3plus_dec_get_scratch_size(const LC3PLUS_Dec*) { return 16; }
+
+int lc3plus_dec_get_output_samples(const LC3PLUS_Dec* decoder) {
+    return decoder->samplerate / 100 * decoder->frame_dms / 100;
+}
+
+LC3PLUS_Error lc3plus_dec16(LC3PLUS_Dec* decoder, void* input_bytes, int num_bytes,
+                            int16_t** output_samples, void*, int) {
+    const unsigned char* frame = (const unsigned char*)input_bytes;
+    bool concealed = num_bytes == 0 || frame[0] == 0;
+
+    int16_t value[2] = {(int16_t)num_bytes, 0};
+    for (int i = 0; i < num_bytes; ++i)
+        value[1] += frame[i];
+
+    for (int c = 0; c < decoder->channels; ++c)
+        for (int i = 0; i < lc3plus_dec_get_output_samples(decoder); ++i)
+            output_samples[c][i] = concealed ? -1 : value[c];
+
+    return concealed ? LC3PLUS_DECODE_ERROR : LC3PLUS_OK;
+}
+}